@@ -1,18 +1,30 @@
 
 #include <lexer/lexer.h>
+#include <lexer/tokenbuffer.h>
+#include <lexer/tokenring.h>
 #include <parser/newparser.h>
+#include <parser/lazybody.h>
+#include <parser/parallelparse.h>
+#include <parser/treedump.h>
+#include <generator/resolver.h>
+#include <generator/codesink.h>
 #include <symtable.h>
 #include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <iostream>
 #include <fstream>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
 
 using namespace std;
 
 extern char *optarg;
 extern int optind, opterr, optopt;
 
-const char *optstr = "tspo:";
+const char *optstr = "tspblzcj:d:o:";
 const struct option longopts[] = {
 	{"help", 0, NULL, 'h'}
 };
@@ -23,6 +35,15 @@ Usage: 	%s -[t|p] file \n\
 Options: \n\
 	-t	tokenize only \n\
 	-p	tokenize & parse \n\
+	-d fmt	tokenize & parse, printing the tree as text, sexpr or binary \n\
+	-b	tokenize the whole file before parsing \n\
+	-l	tokenize on a second thread while parsing \n\
+	-j n	tokenize the whole file, then parse it, on n threads \n\
+		(0 for one per core) \n\
+	-z	tokenize the whole file, and parse a function body only if \n\
+		the function is called \n\
+	-c	with -z, still parse and check every function body, and \n\
+		only leave out the code of those never called \n\
 ";
 
 void printUsageAndDie(const char *prog)
@@ -31,26 +52,61 @@ void printUsageAndDie(const char *prog)
 	exit(EXIT_FAILURE);
 }
 
-void printTokens(IBTLLexer &lex)
+template<class Source>
+void printTokens(Source &lex)
 {
 	Token cur;
-	while(true) {
-		cur = lex.getToken();
-		if(cur.name == TK_EOF) break;
-		else
-			cout << cur << endl;
+	try {
+		while(true) {
+			cur = lex.getToken();
+			if(cur.name == TK_EOF) break;
+			else
+				cout << cur << endl;
+		}
+	}
+	catch(LexException &ex) {
+		cout << "lexer error: " << ex.what() << endl;
+		exit(EXIT_FAILURE);
 	}
 }
 
 
-ProgramNode *parse(IBTLLexer &lexer, bool printTree, const string &filename)
+// a token stream can only be parsed serially
+template<class Source>
+ProgramNode *parseTokens(Source &lexer, Ast &ast, unsigned, LazyBodies *lazy)
+{
+	IBTLParser<Source> parser(lexer, ast);
+	parser.setLazy(lazy);
+	return parser.parse();
+}
+
+// tokens that are all in memory can be parsed on several threads, or
+// with function bodies skipped
+template<>
+ProgramNode *parseTokens(TokenCursor &cursor, Ast &ast, unsigned threads,
+                         LazyBodies *lazy)
+{
+	if(lazy) {
+		IBTLParser<TokenCursor> parser(cursor, ast);
+		parser.setLazy(lazy);
+		return parser.parse();
+	}
+	return parseParallel(cursor.buffer(), ast, threads);
+}
+
+template<class Source>
+ProgramNode *parse(Source &lexer, Ast &ast, unsigned threads, 
+                   LazyBodies *lazy, TreeDumper *dumper, 
+                   const string &filename)
 {
-	IBTLParser parser(lexer);
 	try {
-		ProgramNode *p = parser.parse();
-        if(printTree) {
-		    cout << "Parse tree for " << filename << ":" << endl;
-		    cout << *p << endl;
+		ProgramNode *p = parseTokens(lexer, ast, threads, lazy);
+        if(dumper) {
+            bool text = dumper->dumpFormat() == DUMP_TEXT;
+            if(text)
+		        cout << "Parse tree for " << filename << ":" << endl;
+            dumper->dump(p);
+            if(text) cout << endl;
         }
 		return p;
 	}
@@ -65,17 +121,59 @@ ProgramNode *parse(IBTLLexer &lexer, bool printTree, const string &filename)
 }
 
 
-void printCode(ProgramNode *p, SymbolTable &sym, const string &filename, 
-               const string &outputname, std::ostream &file)
+void printCode(ProgramNode *p, SymbolTable &sym, const string &, 
+               const string &outputname, CodeSink &file)
 {
     try {
-	    p->generate(file, sym, 0);
+        std::vector<std::string> errors;
+        resolveNames(p, errors);
+        if(errors.size()) {
+            cout << std::endl;
+            for(const std::string &err : errors)
+                cout << "code generator error: " << err << endl;
+            remove(outputname.c_str());
+            exit(EXIT_FAILURE);
+        }
+        p->check(CTX_OUTSIDE_FUNC);
+        p->foldConstants();
+        p->reduceStrength();
+	    IrCode ir;
+	    p->generate(ir, sym, 0);
+	    emitGforth(ir, file);
     }
     catch(GenException &ex) {
         cout << std::endl << "code generator error: " << ex.what() << endl;
         remove(outputname.c_str());
         exit(EXIT_FAILURE);
     }
+    // from a lazy function body
+    catch(ParseException &ex) {
+        cout << std::endl << "parse error: " << ex.what() << endl;
+        remove(outputname.c_str());
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+	prints the tokens, the parse tree or the code of one file, reading
+	tokens from 'lexer'
+*/
+template<class Source>
+void compile(Source &lexer, Ast &tree, SymbolTable &symTable, unsigned threads,
+             LazyBodies *lazy, bool tokens_only, TreeDumper *dumper, 
+             const string &filename, const string &outputname, 
+             CodeSink &file)
+{
+	bool parse_only = dumper != NULL;
+	if(tokens_only) printTokens(lexer);
+	else {
+        // a printed tree needs every body
+        if(parse_only) lazy = NULL;
+        ProgramNode *p = parse(lexer, tree, threads, lazy, dumper, 
+                               filename);
+        if(!parse_only)
+            printCode(p, symTable, filename, outputname, file);
+    }
 }
 
 
@@ -84,7 +182,11 @@ void printCode(ProgramNode *p, SymbolTable &sym, const string &filename,
 int main(int argc, char **argv)
 {
 	int opt;
-	bool tokens_only = false, parse_only = false, symbols_only = false;
+	bool tokens_only = false, parse_only = false;
+	bool buffered = false, pipelined = false, lazy = false;
+	bool check_all = false;
+	unsigned threads = 1;
+	DumpFormat format = DUMP_TEXT;
 	string filename;
 	string outputname;
 
@@ -97,11 +199,36 @@ int main(int argc, char **argv)
 			tokens_only = true;
 			break;
 		case 's':
-			symbols_only = true;
+			// accepted, but symbol tables are no longer printed
 			break;
 		case 'p':
 			parse_only = true;
 			break;
+		case 'd':
+			parse_only = true;
+			if(!strcmp(optarg, "text")) format = DUMP_TEXT;
+			else if(!strcmp(optarg, "sexpr")) format = DUMP_SEXPR;
+			else if(!strcmp(optarg, "binary")) format = DUMP_BINARY;
+			else printUsageAndDie(argv[0]);
+			break;
+		case 'b':
+			buffered = true;
+			break;
+		case 'l':
+			pipelined = true;
+			break;
+		case 'z':
+			lazy = true;
+			buffered = true;
+			break;
+		case 'c':
+			check_all = true;
+			break;
+		case 'j':
+			threads = atoi(optarg);
+			if(threads < 1) threads = std::thread::hardware_concurrency();
+			buffered = true;
+			break;
         case 'o':
             outputname = std::string(optarg);
             break;
@@ -115,39 +242,92 @@ int main(int argc, char **argv)
 	}
 
     if(!outputname.size()) outputname = std::string("a.out");
-    std::ofstream outputfile(outputname);
-    if(!outputfile) {
+    int outputfd = open(outputname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if(outputfd < 0) {
         cout << "could not open output file " << outputname << " for writing"
             << endl;
         exit(EXIT_FAILURE);
     }
 
+	// the code of every file is collected here and written out once
+	// at the end
+	CodeSink outputfile;
+
+	// prints the trees for -p and -d, sharing one buffer
+	TreeDumper dumper(cout, format);
+
+	// parse trees are stored here and released all at once after
+	// each file has been compiled
+	Ast tree;
+
 	// main file processing loop
 	int idx = optind;
 	while(idx < argc) {
 		filename = argv[idx];
-		ifstream in(filename);
-		if(!in) {
-			cout << "error: could not open file " << filename << endl;
-			exit(EXIT_FAILURE);
+
+		// regular files are mapped and lexed in place. Anything else
+		// (pipes, ttys) is read through an istream
+		MappedFile mapped(filename);
+		ifstream in;
+		if(!mapped.isMapped()) {
+			in.open(filename);
+			if(!in) {
+				cout << "error: could not open file " << filename << endl;
+				exit(EXIT_FAILURE);
+			}
 		}
-		Reader inputReader(&in);
+		Reader inputReader = mapped.isMapped() ?
+			Reader(mapped.data(), mapped.size()) : Reader(&in);
 		SymbolTable symTable;
-		IBTLLexer lexer(inputReader, symTable);
-        ProgramNode *p;
-
-		if(tokens_only) printTokens(lexer);
-		else {
-            p = parse(lexer, parse_only, filename);
-            if(!parse_only) {
-                printCode(p, symTable, filename, outputname, outputfile);
+		Interner names;
+		IBTLLexer streamLexer(inputReader, names);
+
+        // in buffered mode the parser reads from a cursor over a 
+        // TokenBuffer instead of pulling tokens from the lexer
+        TokenBuffer tokens;
+        TokenCursor cursor(tokens);
+        LazyBodies bodies(tokens);
+        bodies.setCheckAll(check_all);
+        if(buffered) {
+            try {
+                // only a mapped input can be split up between threads
+                if(threads > 1 && mapped.isMapped())
+                    tokens.fillParallel(mapped.data(), mapped.size(), names,
+                                        threads);
+                else
+                    tokens.fill(streamLexer);
             }
+            catch(LexException &ex) {
+                cout << "lexer error: " << ex.what() << endl;
+                exit(EXIT_FAILURE);
+            }
+            compile(cursor, tree, symTable, threads, lazy ? &bodies : NULL,
+                    tokens_only, parse_only ? &dumper : NULL, filename, 
+                    outputname, outputfile);
+        }
+        else if(pipelined) {
+            PipeLexer pipe(streamLexer);
+            compile(pipe, tree, symTable, threads, NULL, tokens_only, 
+                    parse_only ? &dumper : NULL, filename, 
+                    outputname, outputfile);
         }
+        else
+            compile(streamLexer, tree, symTable, threads, NULL, tokens_only,
+                    parse_only ? &dumper : NULL, filename, 
+                    outputname, outputfile);
 		
-		cout << endl;
+		tree.reset();
+		// a binary dump is only its trees, back to back
+		if(!(parse_only && format == DUMP_BINARY)) cout << endl;
 		idx++;
 	}
 
+    if(!outputfile.writeTo(outputfd) || close(outputfd) < 0) {
+        cout << "could not write output file " << outputname << endl;
+        remove(outputname.c_str());
+        exit(EXIT_FAILURE);
+    }
+
 	exit(EXIT_SUCCESS);
 }
 
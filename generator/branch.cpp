@@ -0,0 +1,235 @@
+#include <parser/newnodes.h>
+#include <parser/walk.h>
+#include <unordered_set>
+#include <vector>
+
+/*
+    conditions of ifs and whiles. gforth's if and while take any nonzero
+    cell as true, so a condition need not be turned into a well-formed
+    flag, and its and and or become branches themselves:
+
+        a and b     a if b else false then
+        a or b      a if true else b then
+        not a       a 0=
+
+    their operands are conditions in turn. An int compared with 0 is
+    tested directly, with 0=, 0< and 0>, and x <> 0 is just x. Anything
+    else inside a condition is generated as a value, like elsewhere.
+
+    a branch skips the right operand of and and or, where the value
+    computes both. So only a right operand without effects is branched
+    over: no assignment, and no call unless the function is pure (see
+    FunctionNode::isPure()). Any other and or or stays a value, and both
+    of its operands still run, left first.
+*/
+
+/*
+    collects the nodes of a condition that have an assignment or impure
+    call at or below them, in one walk
+*/
+struct EffectFinder
+{
+    std::unordered_set<NodeId> &effects;
+
+    // for each node on the path walked, whether one was found below it
+    std::vector<bool> found;
+
+    Node *step(Node *node, int step, int, int &)
+    {
+        if(step == 0) {
+            NodeKind k = node->kind();
+            found.push_back(k == NK_ASSIGN || (k == NK_CALL &&
+                            !nodeCast<CallNode>(node)->function()->isPure()));
+        }
+        if(step < node->childCount()) return node->child(step);
+
+        bool f = found.back();
+        found.pop_back();
+        if(f) {
+            effects.insert(node->nodeId());
+            if(!found.empty()) found.back() = true;
+        }
+        return NULL;
+    }
+};
+
+/*
+    looks for what makes a function impure in its body. Variables the
+    function declares are its own; params and the return variable are
+    declared by its id list
+*/
+struct PurityFinder
+{
+    std::unordered_set<SymbolSlot> own;
+    bool impure;
+
+    Node *step(Node *node, int step, int, int &)
+    {
+        switch(node->kind()) {
+        case NK_PRINT:
+            impure = true;
+            break;
+        case NK_CALL:
+            if(step == 0 && !nodeCast<CallNode>(node)->function()->isPure())
+                impure = true;
+            break;
+        case NK_ASSIGN:
+            if(step == 0 && !own.count(nodeCast<AssignNode>(node)->id()->slot()))
+                impure = true;
+            break;
+        case NK_LET:
+            if(step == 0) {
+                VarListNode *vars = nodeCast<LetNode>(node)->varlist();
+                for(int i = 0; i < vars->varCount(); i++)
+                    own.insert(vars->item(i).first->slot());
+            }
+            return NULL;
+        default:
+            break;
+        }
+        if(impure || step >= node->childCount()) return NULL;
+        return node->child(step);
+    }
+};
+
+FunctionNode *CallNode::function()
+{
+    return nodeCast<FunctionNode>(ast->node[ast->declaredBy[funcId()->slot()]]);
+}
+
+bool FunctionNode::isPure()
+{
+    switch(purity) {
+    case PURITY_PURE:       return true;
+    case PURITY_UNKNOWN:    break;
+    default:                return false;
+    }
+
+    purity = PURITY_OPEN;
+    PurityFinder finder{{}, false};
+    IdListNode *ids = idlist();
+    for(int i = 0; i < ids->count(); i++)
+        finder.own.insert(ids->item(i)->slot());
+    walkTree(body(), 0, finder);
+    purity = finder.impure ? PURITY_IMPURE : PURITY_PURE;
+    return !finder.impure;
+}
+
+/*
+    drives testStep() over a condition, and genStep() over the parts of
+    it that are values. 'test' is 1 for nodes that are only tested
+*/
+struct TestWriter
+{
+    IrCode &ir;
+    SymbolTable &sym;
+    std::unordered_set<NodeId> &effects;
+
+    // an and or or whose right operand has to run whatever the left one
+    // gives
+    bool needsValue(Node *node)
+    {
+        if(effects.empty() || !BinopNode::is(node->kind())) return false;
+        BinopNode *b = nodeCast<BinopNode>(node);
+        TokenAttr o = b->op()->attr();
+        return (o == AT_AND || o == AT_OR) &&
+               effects.count(b->right()->nodeId());
+    }
+
+    Node *step(Node *node, int step, int test, int &childTest)
+    {
+        if(test && !needsValue(node)) {
+            bool child = true;
+            Node *next = node->testStep(ir, sym, step, child);
+            childTest = child;
+            return next;
+        }
+        // operators ignore the indent
+        int indent = 0;
+        childTest = 0;
+        return node->genStep(ir, sym, step, 0, indent);
+    }
+};
+
+void Node::generateTest(IrCode &ir, SymbolTable &sym)
+{
+    std::unordered_set<NodeId> effects;
+    EffectFinder finder{effects, {}};
+    walkTree(this, 0, finder);
+
+    TestWriter writer{ir, sym, effects};
+    walkTree(this, 1, writer);
+}
+
+Node *Node::testStep(IrCode &ir, SymbolTable &sym, int step,
+                     bool &childTest)
+{
+    int indent = 0;
+    childTest = false;
+    return genStep(ir, sym, step, 0, indent);
+}
+
+/********************************************************
+ BinopNode
+********************************************************/
+
+Node *BinopNode::testStep(IrCode &ir, SymbolTable &sym, int step,
+                          bool &childTest)
+{
+    TokenAttr o = op()->attr();
+    switch(o) {
+    case AT_AND:
+        if(step == 0) return left();
+        if(step == 1) {
+            ir.op(IR_IF);
+            return right();
+        }
+        ir.op(IR_ELSE);
+        ir.op(IR_FALSE);
+        ir.op(IR_THEN);
+        return NULL;
+    case AT_OR:
+        if(step == 0) return left();
+        if(step == 1) {
+            ir.op(IR_IF);
+            ir.op(IR_TRUE);
+            ir.op(IR_ELSE);
+            return right();
+        }
+        ir.op(IR_THEN);
+        return NULL;
+    default:
+        break;
+    }
+
+    // an int compared with 0 is tested directly
+    TokNode *r = literalOf(right());
+    if((o == AT_NE || o == AT_EQ || o == AT_LT || o == AT_GT) &&
+       r && r->resultType() == TP_INT && r->num().i == 0 &&
+       left()->resultType() == TP_INT) {
+        childTest = false;
+        if(step == 0) return left();
+        // any nonzero int already passes for x != 0
+        if(o == AT_EQ) ir.op(IR_ZERO_EQ);
+        if(o == AT_LT) ir.op(IR_ZERO_LT);
+        if(o == AT_GT) ir.op(IR_ZERO_GT);
+        return NULL;
+    }
+
+    return Node::testStep(ir, sym, step, childTest);
+}
+
+/********************************************************
+ UnopNode
+********************************************************/
+
+Node *UnopNode::testStep(IrCode &ir, SymbolTable &sym, int step,
+                         bool &childTest)
+{
+    if(op()->attr() != AT_NOT)
+        return Node::testStep(ir, sym, step, childTest);
+
+    if(step == 0) return left();
+    ir.op(IR_ZERO_EQ);
+    return NULL;
+}
@@ -0,0 +1,78 @@
+#include <generator/codesink.h>
+#include <charconv>
+#include <algorithm>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+
+static const char tabTable[] = 
+	"\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t"
+	"\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+
+void CodeSink::grow(size_t n)
+{
+	close();
+	size_t size = std::max(n, CHUNK_SIZE);
+	chunks.push_back(Chunk{std::unique_ptr<char[]>(new char[size]), 0});
+	cur = chunks.back().data.get();
+	end = cur + size;
+}
+
+CodeSink &CodeSink::operator <<(int64_t i)
+{
+	char buf[24];
+	char *last = std::to_chars(buf, buf + sizeof(buf), i).ptr;
+	write(buf, last - buf);
+	return *this;
+}
+
+CodeSink &CodeSink::operator <<(Indent tabs)
+{
+	int n = tabs.n;
+	const int max = sizeof(tabTable) - 1;
+	for(; n > max; n -= max) write(tabTable, max);
+	write(tabTable, n);
+	return *this;
+}
+
+size_t CodeSink::size()
+{
+	close();
+	size_t total = 0;
+	for(Chunk &c : chunks) total += c.used;
+	return total;
+}
+
+bool CodeSink::writeTo(int fd)
+{
+	close();
+
+	std::vector<struct iovec> iov;
+	for(Chunk &c : chunks)
+		if(c.used) iov.push_back(iovec{c.data.get(), c.used});
+
+	// writev() takes at most IOV_MAX buffers and may write less than
+	// it was given
+	size_t next = 0;
+	while(next < iov.size()) {
+		int count = std::min(iov.size() - next, size_t(IOV_MAX));
+		ssize_t n = writev(fd, &iov[next], count);
+		if(n < 0) {
+			if(errno == EINTR) continue;
+			return false;
+		}
+		while(n > 0 && size_t(n) >= iov[next].iov_len) {
+			n -= iov[next].iov_len;
+			next++;
+		}
+		if(n > 0) {
+			iov[next].iov_base = (char *)iov[next].iov_base + n;
+			iov[next].iov_len -= n;
+		}
+	}
+
+	chunks.clear();
+	cur = end = NULL;
+	return true;
+}
@@ -0,0 +1,369 @@
+#include <parser/newnodes.h>
+#include <parser/walk.h>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <assert.h>
+
+/*
+    constant folding. foldConstants() walks the tree once check() has
+    typed it. Every node folds its children first; a BinopNode or UnopNode
+    whose operands are then literals computes its value at compile time
+    and hands back a new literal to take its place, and one that cannot
+    change its operand (x*1, x+0, not not b) hands back the operand.
+
+    a value is only folded when it is certain to be what the generated
+    code computes at run time:
+
+    - ints wrap around at 64 bits, like gforth cells
+    - int / and mod are floored, like the generated code (see ir.h). A
+      zero divisor, and the quotient that overflows, are left to run time
+    - ^ is only folded for exponents >= 1. A real ^ is multiplied out
+      in the order the generated code uses, which rounds the same way:
+      a chain from the left up to MAX_REAL_CHAIN, and real-pow's
+      squaring above it (see strength.cpp)
+    - a real result must be finite, since there is no literal for inf
+      or nan, and real mod is left to the run time fmod
+
+    an operand is only kept in place of its operation if it already has
+    the operation's type, so that no int to real conversion is lost.
+    Neither is a real x + 0 or x + 0.0 replaced by x, which is wrong for
+    x = -0.0.
+*/
+
+struct Folder
+{
+    // the node that replaces the one walked last
+    Node *last;
+
+    Node *step(Node *node, int step, int, int &)
+    {
+        return node->foldStep(step, last);
+    }
+};
+
+void Node::foldConstants()
+{
+    Folder folder{this};
+    walkTree(this, 0, folder);
+}
+
+Node *Node::foldStep(int step, Node *&last)
+{
+    if(step > 0 && last != child(step - 1)) replaceChild(step - 1, last);
+    if(step < childCount()) return child(step);
+    last = simplify();
+    return NULL;
+}
+
+Node *FunctionNode::foldStep([[maybe_unused]] int step, Node *&last)
+{
+    // only what check() has typed: the body, if it is generated at all
+    #ifdef ENABLE_FUNCTIONS
+    if(step == 0 && bodyNeeded()) return body();
+    #endif
+    last = this;
+    return NULL;
+}
+
+/********************************************************
+ Literals
+********************************************************/
+
+// an int or real literal as a real, converted the way s>f does
+static double realValue(TokNode *t)
+{
+    return t->resultType() == TP_INT ? double(t->num().i) : t->num().r;
+}
+
+static bool boolValue(TokNode *t)
+{
+    return t->attr() == AT_T;
+}
+
+static bool isInt(TokNode *t, int64_t v)
+{
+    return t && t->resultType() == TP_INT && t->num().i == v;
+}
+
+static bool isReal(TokNode *t, double v)
+{
+    return t && t->resultType() == TP_REAL && t->num().r == v &&
+           !std::signbit(t->num().r);
+}
+
+static bool isNumber(TokNode *t, int64_t v)
+{
+    return isInt(t, v) || isReal(t, double(v));
+}
+
+static bool isBool(TokNode *t, bool v)
+{
+    return t && t->resultType() == TP_BOOL && boolValue(t) == v;
+}
+
+// copies 's' into the tree's arena, where it lives as long as the tree
+static std::string_view keep(Ast &ast, std::string_view s)
+{
+    char *p = static_cast<char *>(ast.arena.allocate(s.size(), 1));
+    memcpy(p, s.data(), s.size());
+    return std::string_view(p, s.size());
+}
+
+// a new literal node of type 'tp' to stand in for 'at'
+static TokNode *literal(Node *at, const tok &t, Type tp)
+{
+    Ast &ast = at->tree();
+    TokNode *n = new (ast.arena) TokNode(ast, t, at->line());
+    ast.type[n->nodeId()] = tp;
+    return n;
+}
+
+static Node *intLiteral(Node *at, int64_t i)
+{
+    char buf[24];
+    char *end = std::to_chars(buf, buf + sizeof(buf), i).ptr;
+    tok t(keep(at->tree(), std::string_view(buf, end - buf)), TK_CONSTANT,
+          AT_INT_DEC);
+    t.num.i = i;
+    return literal(at, t, TP_INT);
+}
+
+static Node *realLiteral(Node *at, double r)
+{
+    char buf[32];
+    char *end = std::to_chars(buf, buf + sizeof(buf), r).ptr;
+    tok t(keep(at->tree(), std::string_view(buf, end - buf)), TK_CONSTANT,
+          AT_REAL);
+    t.num.r = r;
+    return literal(at, t, TP_REAL);
+}
+
+static Node *boolLiteral(Node *at, bool b)
+{
+    return literal(at, tok(TK_CONSTANT, b ? AT_T : AT_F), TP_BOOL);
+}
+
+// the lexemes of string literals keep their quotes
+static Node *strLiteral(Node *at, std::string_view l, std::string_view r)
+{
+    std::string s(l.substr(0, l.size() - 1));
+    s += r.substr(1);
+    tok t(keep(at->tree(), s), TK_CONSTANT, AT_STR);
+    return literal(at, t, TP_STR);
+}
+
+// floored division of 'a' by 'b' != 0, short of INT64_MIN / -1
+static int64_t floorDiv(int64_t a, int64_t b)
+{
+    int64_t q = a / b;
+    if(a % b != 0 && (a < 0) != (b < 0)) q--;
+    return q;
+}
+
+static int64_t floorMod(int64_t a, int64_t b)
+{
+    int64_t r = a % b;
+    if(r != 0 && (r < 0) != (b < 0)) r += b;
+    return r;
+}
+
+static bool canDivide(int64_t a, int64_t b)
+{
+    return b != 0 && !(a == INT64_MIN && b == -1);
+}
+
+// 'a' to the power 'b' >= 1, wrapping around like the generated code
+static uint64_t intPower(uint64_t a, uint64_t b)
+{
+    uint64_t v = 1;
+    for(; b; b >>= 1) {
+        if(b & 1) v *= a;
+        a *= a;
+    }
+    return v;
+}
+
+// 'x' to the power 'n' >= 1 as a chain of multiplies from the left
+static double chainPower(double x, int64_t n)
+{
+    double v = x;
+    for(int64_t i = 1; i < n; i++) v *= x;
+    return v;
+}
+
+// 'x' to the power 'n' >= 1 the way real-pow computes it: the result
+// takes x for each set bit of n, lowest first, as x is squared
+static double squarePower(double x, int64_t n)
+{
+    double v = 1.0;
+    for(; n > 0; n >>= 1) {
+        if(n & 1) v *= x;
+        x *= x;
+    }
+    return v;
+}
+
+template<class T>
+static bool compare(TokenAttr op, T a, T b)
+{
+    switch(op) {
+    case AT_LT:     return a < b;
+    case AT_LE:     return a <= b;
+    case AT_GT:     return a > b;
+    case AT_GE:     return a >= b;
+    case AT_EQ:     return a == b;
+    case AT_NE:     return a != b;
+    default:        assert(0); return false;
+    }
+}
+
+/********************************************************
+ BinopNode
+********************************************************/
+
+Node *BinopNode::foldLiterals(TokNode *l, TokNode *r)
+{
+    TokenAttr o = op()->attr();
+    switch(resultType()) {
+    case TP_INT: {
+        int64_t x = l->num().i;
+        int64_t y = r->num().i;
+        switch(o) {
+        case AT_PLUS:   return intLiteral(this, uint64_t(x) + uint64_t(y));
+        case AT_MINUS:  return intLiteral(this, uint64_t(x) - uint64_t(y));
+        case AT_MULT:   return intLiteral(this, uint64_t(x) * uint64_t(y));
+        case AT_DIV:
+            if(canDivide(x, y)) return intLiteral(this, floorDiv(x, y));
+            break;
+        case AT_MOD:
+            if(canDivide(x, y)) return intLiteral(this, floorMod(x, y));
+            break;
+        case AT_EXP:
+            if(y >= 1) return intLiteral(this, intPower(x, y));
+            break;
+        default:
+            break;
+        }
+        return this;
+    }
+    case TP_REAL: {
+        double x = realValue(l);
+        double y = realValue(r);
+        double v;
+        switch(o) {
+        case AT_PLUS:   v = x + y; break;
+        case AT_MINUS:  v = x - y; break;
+        case AT_MULT:   v = x * y; break;
+        case AT_DIV:    v = x / y; break;
+        case AT_EXP: {
+            // the exponent is an int
+            int64_t n = r->num().i;
+            if(n < 1) return this;
+            v = n <= MAX_REAL_CHAIN ? chainPower(x, n) : squarePower(x, n);
+            break;
+        }
+        default:        return this;
+        }
+        return std::isfinite(v) ? realLiteral(this, v) : this;
+    }
+    case TP_BOOL:
+        switch(o) {
+        case AT_AND:    return boolLiteral(this, boolValue(l) && boolValue(r));
+        case AT_OR:     return boolLiteral(this, boolValue(l) || boolValue(r));
+        default:        break;
+        }
+        // a comparison, made in reals if either side is one
+        if(l->resultType() == TP_REAL || r->resultType() == TP_REAL)
+            return boolLiteral(this, compare(o, realValue(l), realValue(r)));
+        return boolLiteral(this, compare(o, l->num().i, r->num().i));
+    case TP_STR:
+        if(o == AT_PLUS) return strLiteral(this, l->val(), r->val());
+        return this;
+    default:
+        return this;
+    }
+}
+
+Node *BinopNode::foldIdentity(TokNode *l, TokNode *r)
+{
+    OperNode *x = NULL;
+    switch(op()->attr()) {
+    case AT_PLUS:
+        // in reals, -0.0 + 0 is 0.0
+        if(resultType() != TP_INT)      break;
+        if(isInt(r, 0))                 x = left();
+        else if(isInt(l, 0))            x = right();
+        break;
+    case AT_MINUS:
+        if(isNumber(r, 0))              x = left();
+        break;
+    case AT_MULT:
+        if(isNumber(r, 1))              x = left();
+        else if(isNumber(l, 1))         x = right();
+        break;
+    case AT_DIV:
+    case AT_EXP:
+        if(isNumber(r, 1))              x = left();
+        break;
+    case AT_AND:
+        if(isBool(r, true))             x = left();
+        else if(isBool(l, true))        x = right();
+        break;
+    case AT_OR:
+        if(isBool(r, false))            x = left();
+        else if(isBool(l, false))       x = right();
+        break;
+    default:
+        break;
+    }
+    return x && x->resultType() == resultType() ? x : this;
+}
+
+Node *BinopNode::simplify()
+{
+    TokNode *l = literalOf(left());
+    TokNode *r = literalOf(right());
+    if(l && r) return foldLiterals(l, r);
+    return foldIdentity(l, r);
+}
+
+/********************************************************
+ UnopNode
+********************************************************/
+
+Node *UnopNode::simplify()
+{
+    TokenAttr o = op()->attr();
+    if(TokNode *l = literalOf(left())) {
+        switch(resultType()) {
+        case TP_BOOL:
+            return boolLiteral(this, !boolValue(l));
+        case TP_INT:
+            return intLiteral(this, -uint64_t(l->num().i));
+        case TP_REAL: {
+            double x = realValue(l);
+            double v;
+            switch(o) {
+            case AT_MINUS:  v = -x; break;
+            case AT_SIN:    v = std::sin(x); break;
+            case AT_COS:    v = std::cos(x); break;
+            case AT_TAN:    v = std::tan(x); break;
+            default:        return this;
+            }
+            return std::isfinite(v) ? realLiteral(this, v) : this;
+        }
+        default:
+            return this;
+        }
+    }
+
+    // not not b and - - x are their operand
+    if((o == AT_NOT || o == AT_MINUS) && UnopNode::is(left()->kind())) {
+        UnopNode *inner = nodeCast<UnopNode>(left());
+        if(inner->op()->attr() == o &&
+           inner->left()->resultType() == resultType())
+            return inner->left();
+    }
+    return this;
+}
@@ -1,6 +1,7 @@
 
 #include <parser/newnodes.h>
 #include <generator/generator.h>
+#include <parser/walk.h>
 #include <assert.h>
 
 std::string typeString(Type tp)
@@ -28,106 +29,115 @@ Type tokenToType(TokenName name, TokenAttr attr)
     }
 }
 
-void genVar(Stream &str, const std::string &varname, Type type, bool init)
+void genVar(IrCode &ir, const std::string &varname, Type type, bool init)
 {
     if(init)
         switch(type) {
-        case TP_INT:        str << " 0 { W: " << varname << " }"; break;
-        case TP_REAL:       str << " 0e0 { F: " << varname << " }"; break;
-        case TP_BOOL:       str << " false { W: " << varname << " }"; break;
-        case TP_STR:        str << " s\" \" { D: " << varname << " }"; break; // TODO: doubleword notation?
+        case TP_INT:        ir.pushInt(0); break;
+        case TP_REAL:       ir.pushReal(0); break;
+        case TP_BOOL:       ir.op(IR_FALSE); break;
+        case TP_STR:        ir.named(IR_PUSH_STR, "\"\""); break;
         default:            assert(0 && "unexpected case");
         }
-    else
-        switch(type) {
-        case TP_INT:        str << " { W: " << varname << " }"; break;
-        case TP_REAL:       str << " { F: " << varname << " }"; break;
-        case TP_BOOL:       str << " { W: " << varname << " }"; break;
-        case TP_STR:        str << " { D: " << varname << " }"; break; // TODO: doubleword notation?
-        default:            assert(0 && "unexpected case");
+
+    switch(type) {
+    case TP_INT:        ir.named(IR_LOCAL_W, varname); break;
+    case TP_REAL:       ir.named(IR_LOCAL_F, varname); break;
+    case TP_BOOL:       ir.named(IR_LOCAL_W, varname); break;
+    case TP_STR:        ir.named(IR_LOCAL_D, varname); break; // TODO: doubleword notation?
+    default:            assert(0 && "unexpected case");
     }
 }
 
-bool generateVarDec(const std::string &id, Type type, 
-                    Stream &str, SymbolTable &sym, int indent, bool init)
+// declarations were checked and named by resolveNames()
+void generateVarDec(TokNode *id, IrCode &ir, bool init)
 {
-    // every variable name has the depth of its containing scope 
-    // appended to it. This ensures that there are no variables 
-    // with the same name in enclosing scopes
-    std::ostringstream varsuffix;
-    varsuffix << "_" << sym.scopeDepth();
-
-    std::string varname = id + varsuffix.str();
-
-    // try to add to the symbol table, if it already exists at
-    // current scope throw an exception
-    bool ok = sym.declare(id, varname, type);
-    if(!ok) return false;
-
-    genVar(str, varname, type, init);
-    return true;
+    SymbolData &dat = id->binding();
+    genVar(ir, dat.outputName, dat.type, init);
 }
 
 
-Type Node::generate(Stream &str, SymbolTable &sym, int indent)
+/*
+    drives genStep() over the tree; see walkTree()
+*/
+struct CodeWriter
 {
-    std::string tabs(indent, '\t');
-    for(auto iter = children.begin(); iter != children.end(); iter++) {
-        (*iter)->generate(str, sym, indent+1);
-        if(iter != children.end()-1) str << std::endl;
-        str << tabs << "\t";
+    IrCode &ir;
+    SymbolTable &sym;
+
+    Node *step(Node *node, int step, int indent, int &childIndent)
+    {
+        return node->genStep(ir, sym, step, indent, childIndent);
     }
+};
+
+void Node::generate(IrCode &ir, SymbolTable &sym, int indent)
+{
+    CodeWriter writer{ir, sym};
+    walkTree(this, indent, writer);
+}
 
-    return TP_NONE;
+Node *Node::genStep(IrCode &ir, SymbolTable &, int step, int indent,
+                    int &childIndent)
+{
+    // each step after the first follows child step-1
+    int count = childCount();
+    if(step == count) return NULL;
+    if(step > 0) ir.line(indent + 1);
+    childIndent = indent + 1;
+    return child(step);
 }
 
-Type ProgramNode::generate(Stream &str, SymbolTable &sym, int indent)
+Node *ProgramNode::genStep(IrCode &ir, SymbolTable &, int step, int indent,
+                           [[maybe_unused]] int &childIndent)
 {
-    std::string tabs(indent, '\t');
 #ifdef ENABLE_FUNCTIONS
-    scope()->generate(str, sym, indent);
-    str << std::endl << "bye" << std::endl;
+    if(step == 0) {
+        genHelpers(ir);
+        ir.line(indent + 1);
+        return scope();
+    }
+    ir.line(indent);
+    ir.op(IR_BYE);
 #else
-    str << ": prog" << std::endl;
-    str << tabs << "\t";
-    scope()->generate(str, sym, indent+1);
-    str << std::endl << ";" << std::endl;
-    str << "prog bye" << std::endl;
+    if(step == 0) {
+        genHelpers(ir);
+        ir.named(IR_DEFINE, "prog");
+        ir.line(indent + 1);
+        childIndent = indent + 1;
+        return scope();
+    }
+    ir.line(indent);
+    ir.op(IR_END);
+    ir.line(indent);
+    ir.named(IR_CALL, "prog");
+    ir.op(IR_BYE);
 #endif
-    return TP_NONE;
+    return NULL;
 }
 
-Type ContainerScopeNode::generate(Stream &str, SymbolTable &sym, int indent)
+Node *ContainerScopeNode::genStep(IrCode &ir, SymbolTable &sym, int step, 
+                                  int indent, int &childIndent)
 {
-    std::string tabs(indent, '\t');
-    sym.enterScope();
-
 #ifdef ENABLE_FUNCTIONS
     // scopes can only be created in functions
-    if(sym.context() == CTX_INSIDE_FUNC) {
-        
-        str << " scope" << std::endl;
-        // the default generate() method does everything we need here
-        str << tabs << "\t";
-        Node::generate(str, sym, indent);
-        str << std::endl;
-        str << tabs << "endscope";
-    }
-    else {
-        str << tabs << "\t";
-        Node::generate(str, sym, indent);
-    }
+    bool wrapped = sym.context() == CTX_INSIDE_FUNC;
 #else
     // scopes can be created anywhere
-    str << " scope" << std::endl;
-    str << tabs << "\t";
-    Node::generate(str, sym, indent);
-    str << std::endl;
-    str << tabs << "endscope";
+    bool wrapped = true;
 #endif
 
-    sym.exitScope();
-    return TP_NONE;
+    if(step == 0) {
+        if(wrapped) ir.op(IR_SCOPE);
+        ir.line(indent + 1);
+    }
+    // the default genStep() method does everything we need here
+    Node *next = Node::genStep(ir, sym, step, indent, childIndent);
+    if(!next && wrapped) {
+        ir.line(indent);
+        ir.op(IR_ENDSCOPE);
+    }
+    return next;
 }
 
 /********************************************************
@@ -136,151 +146,120 @@ Type ContainerScopeNode::generate(Stream &str, SymbolTable &sym, int indent)
 
 
 
-Type LetNode::generate(Stream &str, SymbolTable &sym, int indent)
+Node *LetNode::genStep(IrCode &ir, SymbolTable &, int, int, int &)
 {
-#ifdef ENABLE_FUNCTIONS
-    if(sym.context() == CTX_OUTSIDE_FUNC)
-        error("let statements cannot be used outside functions");
-#endif
     int count = varlist()->varCount();
-    for(int i = 0; i < count; i++) {
-        auto decl = varlist()->item(i);
-        
-        bool ok = generateVarDec(decl.first, decl.second,
-                                 str, sym, indent, true);
-        if(!ok)
-            error(std::string("variable ") + decl.first + 
-                  std::string(" redefined in same scope"));
-    }
+    for(int i = 0; i < count; i++)
+        generateVarDec(varlist()->item(i).first, ir, true);
 
-    return TP_NONE;
+    return NULL;
 }
 
-Type PrintNode::generate(Stream &str, SymbolTable &sym, int indent)
+Node *PrintNode::genStep(IrCode &ir, SymbolTable &, int step, int, int &)
 {
-    Type t = oper()->generate(str, sym, indent);
-    switch(t) {
+    if(step == 0) return oper();
+    switch(oper()->resultType()) {
     case TP_BOOL:
-    case TP_INT:    str << " ."; break;
-    case TP_REAL:   str << " f."; break;
-    case TP_STR:    str << " type"; break;
+    case TP_INT:    ir.op(IR_PRINT); break;
+    case TP_REAL:   ir.op(IR_FPRINT); break;
+    case TP_STR:    ir.op(IR_TYPE); break;
     default:        assert(0 && "invalid type in print stmt"); break;  
     }
-    return TP_NONE;
-}
-
-Type IfNode::generate(Stream &str, SymbolTable &sym, int indent)
-{
-    #ifdef ENABLE_FUNCTIONS
-        if(sym.context() == CTX_OUTSIDE_FUNC)
-            error("if statements only allowed in functions");
-    #endif
-
-    std::string tabs(indent, '\t');
-    sym.enterScope();
-    Type t = condExpr()->generate(str, sym, indent);
-    if(t != TP_BOOL)
-        typeError(std::string("expected bool condition in if statement"));
-                  
-    str << " scope if" << std::endl;
-    str << tabs << "\t";
-    thenExpr()->generate(str, sym, indent+1);
-    str << std::endl;
-    if(elseExpr()) {
-        str << tabs << "else" << std::endl;
-        str << tabs << "\t";
-        elseExpr()->generate(str, sym, indent+1);
-        str << std::endl;
+    return NULL;
+}
+
+Node *IfNode::genStep(IrCode &ir, SymbolTable &sym, int step, int indent,
+                      int &childIndent)
+{
+    switch(step) {
+    case 0:
+        condExpr()->generateTest(ir, sym);
+        ir.op(IR_SCOPE);
+        ir.op(IR_IF);
+        ir.line(indent + 1);
+        childIndent = indent + 1;
+        return thenExpr();
+    case 1:
+        if(elseExpr()) {
+            ir.line(indent);
+            ir.op(IR_ELSE);
+            ir.line(indent + 1);
+            childIndent = indent + 1;
+            return elseExpr();
+        }
+        break;
+    default:
+        break;
     }
     
-    str << tabs << "endif endscope";
-    sym.exitScope();
-    return TP_NONE;   
-}
-
-Type WhileNode::generate(Stream &str, SymbolTable &sym, int indent)
-{
-    #ifdef ENABLE_FUNCTIONS
-        if(sym.context() == CTX_OUTSIDE_FUNC)
-            error("while statements only allowed in functions");
-    #endif
-
-    std::string tabs(indent, '\t');
-    // if and while statements are scopes
-    sym.enterScope();
-
-    str << " scope begin" << std::endl;
-    str << tabs << "\t";
-    Type t = condExpr()->generate(str, sym, indent);
-    if(t != TP_BOOL)
-        typeError(std::string("expected bool condition in while loop"));
-    str << std::endl;
-    str << tabs << "while" << std::endl;
-    str << tabs << "\t";
-    bodyList()->generate(str, sym, indent);
-    str << std::endl;
-    str << tabs << "repeat endscope";
-    sym.exitScope();
-    return TP_NONE;
+    ir.line(indent);
+    ir.op(IR_THEN);
+    ir.op(IR_ENDSCOPE);
+    return NULL;
+}
+
+Node *WhileNode::genStep(IrCode &ir, SymbolTable &sym, int step, int indent,
+                         int &)
+{
+    switch(step) {
+    case 0:
+        ir.op(IR_SCOPE);
+        ir.op(IR_BEGIN);
+        ir.line(indent + 1);
+        condExpr()->generateTest(ir, sym);
+        ir.line(indent);
+        ir.op(IR_WHILE);
+        ir.line(indent + 1);
+        return bodyList();
+    default:
+        ir.line(indent);
+        ir.op(IR_REPEAT);
+        ir.op(IR_ENDSCOPE);
+        return NULL;
+    }
 }
 
-Type FunctionNode::generate(Stream &str, SymbolTable &sym, int indent)
+Node *FunctionNode::genStep([[maybe_unused]] IrCode &ir,
+                            [[maybe_unused]] SymbolTable &sym,
+                            [[maybe_unused]] int step,
+                            [[maybe_unused]] int indent,
+                            [[maybe_unused]] int &childIndent)
 {
     #ifdef ENABLE_FUNCTIONS
-    if(sym.context() == CTX_INSIDE_FUNC)
-        error("nested functions not allowed");
-    sym.setContext(CTX_INSIDE_FUNC);
-
-    std::string tabs(indent, '\t');
-    std::ostringstream funcName;
-    int idCount = idlist()->count();
-    int typeCount = typelist()->count();
-    if(idCount != typeCount || idCount == 0)
-        error("id list and type list in function declaration must be same size");
-    funcName << idlist()->item(0);
-    std::string returnVar = idlist()->item(0);    
-    Type returnType = typelist()->item(0);
-    
-    // add function name to symbol table
-    std::vector<Type> paramTypes;
-    for(int i = 1; i < typeCount; i++)
-        paramTypes.push_back(typelist()->item(i));
-    bool ok = sym.declareFunction(idlist()->item(0), funcName.str(), 
-                                  returnType, paramTypes);
-    if(!ok)
-        error("function redefined in current scope");
-
-    sym.enterScope();
-    str << " : " << funcName.str() << std::endl;
-    str << tabs << "\t";
-    // generate param list
-    for(int i = 1; i < idCount; i++) {
-        ok = generateVarDec(idlist()->item(i), typelist()->item(i),
-                                 str, sym, indent, false);
-        if(!ok)
-            error(std::string("redefined function parameter ") + idlist()->item(i));
+    TokNode *returnVar = idlist()->item(0);
+
+    switch(step) {
+    case 0: {
+        // a lazy function nothing calls is never parsed or emitted
+        if(!bodyNeeded()) return NULL;
+
+        sym.setContext(CTX_INSIDE_FUNC);
+        int idCount = idlist()->count();
+        ir.named(IR_DEFINE, returnVar->val());
+        ir.line(indent + 1);
+        // generate param list
+        for(int i = 1; i < idCount; i++)
+            generateVarDec(idlist()->item(i), ir, false);
+        // generate return variable
+        generateVarDec(returnVar, ir, true);
+        ir.line(indent + 1);
+        // generate body
+        childIndent = indent + 1;
+        return body();
+    }
+    case 1:
+        ir.line(indent + 1);
+        // put return value on stack
+        // HACK
+        return returnVar;
+    default:
+        ir.line(indent);
+        ir.op(IR_END);
+        sym.setContext(CTX_OUTSIDE_FUNC);
+        return NULL;
     }
-    // generate return variable
-    ok = generateVarDec(returnVar, returnType,
-                        str, sym, indent, true);
-    if(!ok)
-        error(std::string("return variable has same name as function parameter "));
-    str << std::endl;
-    str << tabs << "\t";
-    // generate body
-    body()->generate(str, sym, indent+1);
-    str << std::endl;
-    str << tabs << "\t";
-    // put return value on stack
-    // HACK
-    idlist()->children[0]->generate(str, sym, indent);
-    str << std::endl << tabs << ";" << std::endl;
-
-    sym.exitScope();
-    sym.setContext(CTX_OUTSIDE_FUNC);
-    return returnType;
     #else
-    return TP_NONE;
+    return NULL;
     #endif
 }
 
@@ -288,120 +267,91 @@ Type FunctionNode::generate(Stream &str, SymbolTable &sym, int indent)
  AssignNode
 ********************************************************/
 
-Type AssignNode::typeCheck(Type ltype, Type rtype)
-{
-    if(ltype == TP_REAL) {
-        if(rtype == TP_REAL || rtype == TP_INT ) return TP_REAL;
-        typeError("expected numeric rvalue");
-    }
-    if(ltype == TP_INT) {
-        if(rtype == TP_INT) return TP_INT;
-        typeError("expected int rvalue");
-    }
-    if(ltype == TP_BOOL) {
-        if(rtype == TP_BOOL) return TP_BOOL;
-        typeError("expected bool rvalue");
-    }
-    if(ltype == TP_STR) {
-        if(rtype == TP_STR) return TP_STR;
-        typeError("expected str rvalue");
-    }
-    assert(0 && "we should not be here");
-}
-
-Type AssignNode::generate(Stream &str, SymbolTable &sym, int indent)
+Node *AssignNode::genStep(IrCode &ir, SymbolTable &, int step, int, int &)
 {
-    // find the identifier in the symbol table
-    SymbolData dat;
-    bool ok = sym.find(id()->val(), dat);
-    if(!ok)
-        error(std::string("undeclared variable ") + id()->val());
-
-    Type ltype = dat.type;
-    Type rtype = oper()->generate(str, sym, indent);
-
-    // verify that left and right types are compatible
-    Type outtype = typeCheck(ltype, rtype);
+    if(step == 0) return oper();
 
     // cast int rvalue to float if necessary
-    if(outtype == TP_REAL && rtype == TP_INT)
-        str << " s>f";
+    if(resultType() == TP_REAL && oper()->resultType() == TP_INT)
+        ir.op(IR_S_TO_F);
  
-    str << " TO " << dat.outputName;
-    str << " " << dat.outputName;
-    return outtype;
+    SymbolData &dat = id()->binding();
+    ir.named(IR_STORE, dat.outputName);
+    ir.named(IR_LOAD, dat.outputName);
+    return NULL;
 }
 
 /********************************************************
  BinopNode
 ********************************************************/
 
-void BinopNode::genReal(Type l, Type r, Stream &str)
+void BinopNode::genReal(Type l, Type r, IrCode &ir)
 {
     // if either operand is an int, cast to real
     // unless operator is exp
     if(op()->attr() != AT_EXP) {
         if(l == TP_INT) {
             assert(r == TP_REAL);
-            str << " s>f fswap";
+            ir.op(IR_S_TO_F);
+            ir.op(IR_FSWAP);
         } else if(r == TP_INT) {
             assert(l == TP_REAL);
-            str << " s>f";
+            ir.op(IR_S_TO_F);
         }
     }
 
     switch(op()->attr()) {
-    case AT_PLUS:   str << " f+"; break;
-    case AT_MINUS:  str << " f-"; break;
-    case AT_MULT:   str << " f*"; break;
-    case AT_DIV:    str << " f/"; break;
-    case AT_MOD:    str << " fmod"; break;
-    case AT_EXP:    str << " 1e0 0 do fover f* loop fnip"; break;
-    case AT_LT:     str << " f<"; break;
-    case AT_LE:     str << " f<="; break;
-    case AT_GT:     str << " f>"; break;
-    case AT_GE:     str << " f>="; break;
-    case AT_EQ:     str << " f="; break;
-    case AT_NE:     str << " f<>"; break;
+    case AT_PLUS:   ir.op(IR_FADD); break;
+    case AT_MINUS:  ir.op(IR_FSUB); break;
+    case AT_MULT:   ir.op(IR_FMUL); break;
+    case AT_DIV:    ir.op(IR_FDIV); break;
+    case AT_MOD:    ir.op(IR_FMOD); break;
+    case AT_EXP:    ir.named(IR_CALL, "real-pow"); break;
+    case AT_LT:     ir.op(IR_FLT); break;
+    case AT_LE:     ir.op(IR_FLE); break;
+    case AT_GT:     ir.op(IR_FGT); break;
+    case AT_GE:     ir.op(IR_FGE); break;
+    case AT_EQ:     ir.op(IR_FEQ); break;
+    case AT_NE:     ir.op(IR_FNE); break;
     default:        assert(0); break;
     }   
 }
 
-void BinopNode::genInt(Stream &str)
+void BinopNode::genInt(IrCode &ir)
 {
     switch(op()->attr()) {
-    case AT_PLUS:   str << " +"; break;
-    case AT_MINUS:  str << " -"; break; // TODO: make MINUS an attr
-    case AT_MULT:   str << " *"; break;
-    case AT_DIV:    str << " /"; break;
-    case AT_MOD:    str << " mod"; break;
-    case AT_EXP:    str << " 1 swap 0 do over * loop nip"; break;
-    case AT_LT:     str << " <"; break;
-    case AT_GT:     str << " >"; break;
-    case AT_LE:     str << " <="; break;
-    case AT_GE:     str << " >="; break;
-    case AT_EQ:     str << " ="; break;
-    case AT_NE:     str << " <>"; break;
+    case AT_PLUS:   ir.op(IR_ADD); break;
+    case AT_MINUS:  ir.op(IR_SUB); break; // TODO: make MINUS an attr
+    case AT_MULT:   ir.op(IR_MUL); break;
+    case AT_DIV:    ir.op(IR_DIV); break;
+    case AT_MOD:    ir.op(IR_MOD); break;
+    case AT_EXP:    ir.named(IR_CALL, "int-pow"); break;
+    case AT_LT:     ir.op(IR_LT); break;
+    case AT_GT:     ir.op(IR_GT); break;
+    case AT_LE:     ir.op(IR_LE); break;
+    case AT_GE:     ir.op(IR_GE); break;
+    case AT_EQ:     ir.op(IR_EQ); break;
+    case AT_NE:     ir.op(IR_NE); break;
     default:        assert(0); break;
     }
 }
 
-void BinopNode::genBool(Type l, Type r, Stream &str)
+void BinopNode::genBool(Type l, Type r, IrCode &ir)
 {
     switch(op()->attr()) {
-    case AT_AND:    str << " and"; return;
-    case AT_OR:     str << " or"; return;
+    case AT_AND:    ir.op(IR_AND); return;
+    case AT_OR:     ir.op(IR_OR); return;
     default: 
         break;  
     }
 
     // if we fall down here, we are looking at one of the 
     // comparison ops
-    if(l == TP_REAL || r == TP_REAL) genReal(l, r, str);
-    else                             genInt(str);
+    if(l == TP_REAL || r == TP_REAL) genReal(l, r, ir);
+    else                             genInt(ir);
 }
 
-void BinopNode::genStr(Stream &str)
+void BinopNode::genStr(IrCode &)
 {
     switch(op()->attr()) {
     case AT_PLUS:
@@ -411,259 +361,140 @@ void BinopNode::genStr(Stream &str)
     }
 }
 
-Type BinopNode::typeCheckBoolOp(Type l, Type r)
-{
-    if(l == TP_BOOL && r == TP_BOOL)        return TP_BOOL;
-    binopError(std::string("expected bool operands to binary ") +
-               opString(), l, r);
-}
-
-Type BinopNode::typeCheckCompareOp(Type l, Type r)
-{
-    if((l == TP_REAL || l == TP_INT) &&
-       (r == TP_REAL || r == TP_INT))       return TP_BOOL;
-    binopError(std::string("expected numeric operands to binary ") +
-              opString(), l, r);
-}
-
-Type BinopNode::typeCheckNumOp(Type l, Type r)
-{
-    if(l == TP_REAL || r == TP_REAL) {
-        if((l == TP_REAL || l == TP_INT) &&
-           (r == TP_REAL || r == TP_INT))   return TP_REAL;
-        binopError(std::string("expected numeric operands to binary ") +
-                   opString(), l, r);
-    }
-    if(l == TP_INT && r == TP_INT)          return TP_INT;
-    binopError(std::string("expected numeric operands to binary ") +
-              opString(), l, r);
-}
-
-Type BinopNode::typeCheckExpOp(Type l, Type r)
-{
-    if(l == TP_INT && r == TP_INT)          return TP_INT;
-    if(l == TP_REAL && r == TP_INT)         return TP_REAL;
-    binopError(std::string("expected numeric left arg and int right arg to binary ") +
-               opString(), l, r); 
-}
-
-Type BinopNode::typeCheck(Type l, Type r)
+Node *BinopNode::genStep(IrCode &ir, SymbolTable &, int step, int, int &)
 {
-    switch(op()->attr()) {
-    case AT_PLUS:
-        if(l == TP_STR && r == TP_STR) return TP_STR;
-        return typeCheckNumOp(l, r);
-        break;
-    case AT_MINUS:
-    case AT_MULT:
-    case AT_DIV:
-    case AT_MOD:
-        return typeCheckNumOp(l, r); 
-        break;
-    case AT_EXP:
-        return typeCheckExpOp(l, r);
-        break;
-    case AT_LT:
-    case AT_LE:
-    case AT_GT:
-    case AT_GE:
-    case AT_EQ:
-    case AT_NE:
-        return typeCheckCompareOp(l, r);
-        break;
-    case AT_AND:
-    case AT_OR:
-        return typeCheckBoolOp(l, r);
-        break;
-    default: assert(0); break;
+    // an operand that strength reduction builds into the operator's 
+    // code is not pushed
+    TokNode *k = constOperand();
+    if(k) {
+        if(step == 0) return k == left() ? right() : left();
+        genReduced(k, ir);
+        return NULL;
     }
-}
-
-Type BinopNode::generate(Stream &str, SymbolTable &sym, int indent)
-{
-    Type l = left()->generate(str, sym, indent);
-    Type r = right()->generate(str, sym, indent);
-    Type exprType = typeCheck(l, r);
-    switch(exprType) {
-    case TP_BOOL:       genBool(l, r, str); break;
-    case TP_REAL:       genReal(l, r, str); break;
-    case TP_INT:        genInt(str); break;
-    case TP_STR:        genStr(str); break;
+    if(step == 0) return left();
+    if(step == 1) return right();
+
+    Type l = left()->resultType();
+    Type r = right()->resultType();
+    switch(resultType()) {
+    case TP_BOOL:       genBool(l, r, ir); break;
+    case TP_REAL:       genReal(l, r, ir); break;
+    case TP_INT:        genInt(ir); break;
+    case TP_STR:        genStr(ir); break;
     default:            assert(0); break;
     }
     
-    return exprType;
+    return NULL;
 }
 
 /********************************************************
  UnopNode
 ********************************************************/
 
-void UnopNode::genReal(Type l, Stream &str)
+void UnopNode::genReal(Type l, IrCode &ir)
 {
     // cast int to real
     if(l == TP_INT) {
-        str << " s>f";
+        ir.op(IR_S_TO_F);
     }
 
     switch(op()->attr()) {
-    case AT_MINUS:      str << " fnegate"; break;
-    case AT_SIN:        str << " fsin"; break;
-    case AT_COS:        str << " fcos"; break;
-    case AT_TAN:        str << " ftan"; break;
+    case AT_MINUS:      ir.op(IR_FNEGATE); break;
+    case AT_SIN:        ir.op(IR_FSIN); break;
+    case AT_COS:        ir.op(IR_FCOS); break;
+    case AT_TAN:        ir.op(IR_FTAN); break;
     default:            assert(0 && "unexpected case"); break;
     }
 }
 
-void UnopNode::genInt(Stream &str)
+void UnopNode::genInt(IrCode &ir)
 {
     switch(op()->attr()) {
-    case AT_MINUS:      str << " negate"; break;
+    case AT_MINUS:      ir.op(IR_NEGATE); break;
     default:            assert(0 && "unexpected case"); break;  
     }
 }
 
-void UnopNode::genBool(Stream &str)
+void UnopNode::genBool(IrCode &ir)
 {
     switch(op()->attr()) {
-    case AT_NOT:        str << " invert"; break;
+    case AT_NOT:        ir.op(IR_INVERT); break;
     default:            assert(0 && "unexpected case"); break;
     }
 }
 
-Type UnopNode::typeCheck(Type l)
+Node *UnopNode::genStep(IrCode &ir, SymbolTable &, int step, int, int &)
 {
-    switch(op()->attr()) {
-    case AT_NOT:
-        if(l == TP_BOOL)    return TP_BOOL;
-        unopError(std::string("expected bool operand to unary not"), l);
-        break;
-    case AT_MINUS:
-        if(l == TP_INT)     return TP_INT;
-        if(l == TP_REAL)    return TP_REAL;
-        unopError(std::string("expected numeric operand to unary -"), l);
-    case AT_SIN:
-    case AT_COS:
-    case AT_TAN:
-        if(l == TP_REAL || l == TP_INT) return TP_REAL;
-        unopError(std::string("expected numeric operand to unary ") + 
-                  opString(), l);
-    default:
-        assert(0 && "unhandled unary operator in switch case");
-        break;
-    }
-}
+    if(step == 0) return left();
 
-Type UnopNode::generate(Stream &str, SymbolTable &sym, int indent)
-{
-    Type l = left()->generate(str, sym, indent);
-    Type exprType = typeCheck(l);
-    switch(exprType) {
-    case TP_BOOL:       genBool(str); break;
-    case TP_INT:        genInt(str); break;
-    case TP_REAL:       genReal(l, str); break;
+    switch(resultType()) {
+    case TP_BOOL:       genBool(ir); break;
+    case TP_INT:        genInt(ir); break;
+    case TP_REAL:       genReal(left()->resultType(), ir); break;
     case TP_STR:
     default:
         assert(0 && "unexpected case");
         break;    
     }
 
-    return exprType;
+    return NULL;
 }
 
 /********************************************************
  CallNode
 ******************************************************/
 
-void CallNode::typeCheck(SymbolData &dat, int paramIndex, Type paramType)
-{
-   if(paramType != dat.paramType[paramIndex]) {
-        std::ostringstream str;
-        str << "arg #" << paramIndex+1 << " has type " << typeString(paramType) <<
-            " but function expects " << typeString(dat.paramType[paramIndex]);
-        typeError(str.str());
-   }
-}
-
-Type CallNode::generate(Stream &str, SymbolTable &sym, int indent)
+Node *CallNode::genStep(IrCode &ir, SymbolTable &, int step, int, int &)
 {
-    // find the function in the symbol table
-    SymbolData dat;
-    bool ok = sym.find(funcId()->val(), dat);
-    if(!ok)
-        error(std::string("undeclared function ") + funcId()->val());
-    if(dat.paramCount != paramCount())
-        error("wrong number of args to function");
-
     // push params onto stack in reverse order
-    for(int i = paramCount() - 1; i >= 0; i--) {
-        Type paramType = param(i)->generate(str, sym, indent);
-        typeCheck(dat, i, paramType);
-    }
+    if(step < paramCount()) return param(paramCount() - 1 - step);
 
     // call function
-    str << " " << dat.outputName;
-    return dat.type;
+    ir.named(IR_CALL, funcId()->binding().outputName);
+    return NULL;
 }
 
 /********************************************************
  TokNode
 ********************************************************/
 
-void TokNode::genReal(Stream &str)
-{
-    const std::string &val = token.val;
-    str << " " << val;
-    // if the token value does not contain an 'e' or 'E',
-    // append 'e0' to the value
-    if(val.find('e') == std::string::npos &&
-       val.find('E') == std::string::npos)
-        str << "e0";
-}
-
-void TokNode::genBool(Stream &str)
+void TokNode::genBool(IrCode &ir)
 {
     switch(token.attr) {
-    case AT_T:      str << " true"; break;
-    case AT_F:      str << " false"; break;
+    case AT_T:      ir.op(IR_TRUE); break;
+    case AT_F:      ir.op(IR_FALSE); break;
     default:        assert(0 && "unexpected case"); break;
     }
 }
 
-Type TokNode::genVariable(Stream &str, SymbolTable &sym)
-{
-    // find the identifier in the symbol table
-    SymbolData dat;
-    bool ok = sym.find(val(), dat);
-    if(!ok)
-        error(std::string("undeclared variable ") + val());
-
-    str << " " << dat.outputName;
-    return dat.type;
-}
 
-Type TokNode::generate(Stream &str, SymbolTable &sym, int indent)
+Node *TokNode::genStep(IrCode &ir, SymbolTable &, int, int, int &)
 {
-    if(token.name == TK_ID) return genVariable(str, sym);
+    if(token.name == TK_ID) {
+        ir.named(IR_LOAD, binding().outputName);
+        return NULL;
+    }
 
     switch(token.attr) {
     case AT_INT_OCT:
     case AT_INT_HEX:
     case AT_INT_DEC:
-        str << " " << token.val;
-        return TP_INT;
+        // emitted in decimal, whatever base the source used
+        ir.pushInt(token.num.i);
+        break;
     case AT_REAL:
-        genReal(str);
-        return TP_REAL;
+        ir.pushReal(token.num.r);
+        break;
     case AT_T:
     case AT_F:
-        genBool(str);
-        return TP_BOOL;
+        genBool(ir);
+        break;
     case AT_STR:
-        str << " s\" " << token.val.substr(1, std::string::npos);
-        return TP_STR;
+        ir.named(IR_PUSH_STR, token.val);
+        break;
     default: assert(0 && "unknown literal type"); break;
     }
+    return NULL;
 }
 
 
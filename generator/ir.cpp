@@ -0,0 +1,89 @@
+#include <generator/ir.h>
+#include <charconv>
+#include <assert.h>
+
+// the gforth code of each op that takes no argument, by IrOp
+static const char *const words[] = {
+	NULL, NULL, NULL, "true", "false", NULL, NULL, NULL, NULL, NULL,
+
+	"+", "-", "*", "swap s>d rot fm/mod nip", "swap s>d rot fm/mod drop",
+	"negate", "lshift", "rshift", "arshift", "and", "or", "invert", "<",
+	"<=", ">", ">=", "=", "<>", "0=", "0<", "0>",
+
+	"s>f", "f+", "f-", "f*", "f/", "fmod", "fnegate", "fsin", "fcos",
+	"ftan", "f<", "f<=", "f>", "f>=", "f=", "f<>",
+
+	"dup", "drop", "2drop", "swap", "over", "nip", "rot", "-rot", "pick",
+	"fdup", "fdrop", "fswap", "fover", "fnip",
+
+	".", "f.", "type",
+
+	"if", "else", "then", "begin", "while", "repeat", "scope", "endscope",
+	NULL, NULL, ";", "bye",
+
+	NULL
+};
+
+static_assert(sizeof(words) / sizeof(words[0]) == IR_LINE + 1,
+              "a word for every op");
+
+// the shortest text that reads back as the same double, as a float
+static void emitReal(double r, CodeSink &out)
+{
+	char buf[32];
+	char *end = std::to_chars(buf, buf + sizeof(buf), r).ptr;
+	std::string_view val(buf, end - buf);
+	out << val;
+	// without an exponent gforth would read an int
+	if(val.find('e') == std::string_view::npos)
+		out << "e0";
+}
+
+static void emitLocal(const char *kind, std::string_view name, CodeSink &out)
+{
+	out << "{ " << kind << " " << name << " }";
+}
+
+void emitGforth(const IrCode &ir, CodeSink &out)
+{
+	// ops are separated by a space, unless an IR_LINE comes between
+	// them. Only the last of several IR_LINEs in a row counts
+	bool first = true;
+	int indent = -1;
+
+	for(const IrInst &inst : ir.code) {
+		if(inst.op == IR_LINE) {
+			indent = inst.arg;
+			continue;
+		}
+		if(indent >= 0) {
+			if(!first) out << '\n';
+			out << Indent(indent);
+			indent = -1;
+		}
+		else if(!first)
+			out << ' ';
+		first = false;
+
+		switch(inst.op) {
+		case IR_PUSH_INT:   out << ir.ints[inst.arg]; break;
+		case IR_PUSH_REAL:  emitReal(ir.reals[inst.arg], out); break;
+		case IR_PUSH_STR:
+			// the lexeme's opening quote becomes s"
+			out << "s\" " << ir.names[inst.arg].substr(1);
+			break;
+		case IR_LOAD:       out << ir.names[inst.arg]; break;
+		case IR_STORE:      out << "TO " << ir.names[inst.arg]; break;
+		case IR_LOCAL_W:    emitLocal("W:", ir.names[inst.arg], out); break;
+		case IR_LOCAL_F:    emitLocal("F:", ir.names[inst.arg], out); break;
+		case IR_LOCAL_D:    emitLocal("D:", ir.names[inst.arg], out); break;
+		case IR_CALL:       out << ir.names[inst.arg]; break;
+		case IR_DEFINE:     out << ": " << ir.names[inst.arg]; break;
+		default:
+			assert(words[inst.op]);
+			out << words[inst.op];
+			break;
+		}
+	}
+	if(!first) out << '\n';
+}
@@ -0,0 +1,164 @@
+#include <generator/resolver.h>
+#include <parser/walk.h>
+#include <sstream>
+
+namespace {
+
+class Resolver
+{
+    Ast &ast;
+    SymbolTable sym;
+    std::vector<std::string> &errors;
+
+    void error(Node *n, const std::string &msg)
+    {
+        std::ostringstream str;
+        str << "line " << n->line() << ": " << msg;
+        errors.push_back(str.str());
+    }
+
+    // records a declaration made in 'sym' by node 'by'
+    void record(SymbolData *dat, Node *by)
+    {
+        dat->slot = ast.symbols.size();
+        ast.symbols.push_back(*dat);
+        ast.declaredBy.push_back(by->nodeId());
+    }
+
+    /*
+        every variable name has the depth of its containing scope
+        appended to it. This ensures that there are no variables
+        with the same name in enclosing scopes
+    */
+    SymbolData *declareVar(TokNode *id, Type type)
+    {
+        std::ostringstream varname;
+        varname << id->val() << "_" << sym.scopeDepth();
+        SymbolData *dat = sym.declare(id->symbol(), varname.str(), type);
+        if(dat) {
+            record(dat, id);
+            id->bind(dat->slot);
+        }
+        return dat;
+    }
+
+    // binds a use of 'id', or reports it on the line of 'at'
+    void use(TokNode *id, Node *at, const char *what)
+    {
+        SymbolData *dat = sym.find(id->symbol());
+        if(dat)
+            id->bind(dat->slot);
+        else
+            error(at, std::string("undeclared ") + what + " " + 
+                      std::string(id->val()));
+    }
+
+    void let(LetNode *n)
+    {
+        VarListNode *vars = n->varlist();
+        for(int i = 0; i < vars->varCount(); i++) {
+            auto decl = vars->item(i);
+            if(!declareVar(decl.first, decl.second))
+                error(n, std::string("variable ") + 
+                         std::string(decl.first->val()) +
+                         std::string(" redefined in same scope"));
+        }
+    }
+
+    // declares a function and opens its scope. Returns false if there
+    // is no body to resolve
+    bool function(FunctionNode *n)
+    {
+        IdListNode *ids = n->idlist();
+        TypeListNode *types = n->typelist();
+        int idCount = ids->count();
+        if(idCount != types->count() || idCount == 0) {
+            error(n, "id list and type list in function declaration must be same size");
+            return false;
+        }
+
+        TokNode *name = ids->item(0);
+        Type returnType = types->item(0);
+        std::vector<Type> paramTypes;
+        for(int i = 1; i < idCount; i++)
+            paramTypes.push_back(types->item(i));
+        SymbolData *dat = sym.declareFunction(name->symbol(), 
+                                              std::string(name->val()),
+                                              returnType, paramTypes);
+        if(!dat) {
+            error(n, "function redefined in current scope");
+            return false;
+        }
+        // the name itself is bound to the return variable, below
+        record(dat, n);
+        if(!n->bodyChecked()) return false;
+
+        sym.enterScope();
+        for(int i = 1; i < idCount; i++)
+            if(!declareVar(ids->item(i), types->item(i)))
+                error(n, std::string("redefined function parameter ") + 
+                         std::string(ids->item(i)->val()));
+        if(!declareVar(name, returnType))
+            error(n, std::string("return variable has same name as function parameter "));
+        return true;
+    }
+
+public:
+    Resolver(Ast &ast, std::vector<std::string> &errors) :
+        ast(ast),
+        sym(),
+        errors(errors)
+    {}
+
+    // one step of the walk; see walkTree()
+    Node *step(Node *n, int step, int, int &)
+    {
+        switch(n->kind()) {
+        case NK_TOKEN: {
+            TokNode *tok = nodeCast<TokNode>(n);
+            if(tok->type() == TK_ID) use(tok, tok, "variable");
+            return NULL;
+        }
+        case NK_SCOPE:
+        case NK_IF:
+        case NK_WHILE:
+            // if and while statements are scopes
+            if(step == 0) sym.enterScope();
+            if(step < n->childCount()) return n->child(step);
+            sym.exitScope();
+            return NULL;
+        case NK_ASSIGN: {
+            AssignNode *assign = nodeCast<AssignNode>(n);
+            if(step > 0) return NULL;
+            use(assign->id(), assign, "variable");
+            return assign->oper();
+        }
+        case NK_CALL: {
+            CallNode *call = nodeCast<CallNode>(n);
+            if(step == 0) use(call->funcId(), call, "function");
+            return step < call->paramCount() ? call->param(step) : NULL;
+        }
+        case NK_LET:
+            let(nodeCast<LetNode>(n));
+            return NULL;
+        case NK_FUNCTION: {
+#ifdef ENABLE_FUNCTIONS
+            FunctionNode *fn = nodeCast<FunctionNode>(n);
+            if(step == 0) return function(fn) ? fn->body() : NULL;
+            sym.exitScope();
+#endif
+            return NULL;
+        }
+        default:
+            return step < n->childCount() ? n->child(step) : NULL;
+        }
+    }
+};
+
+}
+
+void resolveNames(ProgramNode *program, std::vector<std::string> &errors)
+{
+    Resolver resolver(program->tree(), errors);
+    walkTree(program, 0, resolver);
+}
@@ -0,0 +1,214 @@
+#include <parser/newnodes.h>
+#include <parser/walk.h>
+#include <assert.h>
+
+/*
+    strength reduction. Operations with a suitable literal operand are
+    generated as cheaper code that has the literal built in:
+
+    - int * 2^k is k lshift, on either side
+    - int / 2^k is k arshift and int mod 2^k is 2^k-1 and. Int division
+      is floored (see ir.h), under which both give the same result as
+      / and mod for any dividend
+    - x ^ n for an int x and a literal n >= 1 is a chain of squarings
+      and multiplies, in which order does not matter as ints wrap
+    - x ^ n for a real x and a literal 1 <= n <= MAX_REAL_CHAIN is an
+      unrolled chain of n-1 multiplies, x * x * ... from the left
+
+    any other ^ calls a helper word, int-pow or real-pow, that squares
+    and multiplies in O(log n) steps and gives 1 for n < 1. The helpers
+    the program needs are defined before it.
+*/
+
+static bool isPowerOfTwo(TokNode *t)
+{
+    if(!t || t->resultType() != TP_INT) return false;
+    int64_t n = t->num().i;
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+// the highest bit set in n > 0, which for a power of two is its log
+static int topBit(int64_t n)
+{
+    return 63 - __builtin_clzll(n);
+}
+
+TokNode *BinopNode::constOperand()
+{
+    TokNode *r = literalOf(right());
+    switch(op()->attr()) {
+    case AT_MULT:
+        if(resultType() != TP_INT) return NULL;
+        if(isPowerOfTwo(r)) return r;
+        if(isPowerOfTwo(literalOf(left()))) return literalOf(left());
+        return NULL;
+    case AT_DIV:
+    case AT_MOD:
+        if(resultType() != TP_INT) return NULL;
+        return isPowerOfTwo(r) ? r : NULL;
+    case AT_EXP:
+        if(!r || r->num().i < 1) return NULL;
+        if(resultType() == TP_REAL && r->num().i > MAX_REAL_CHAIN) return NULL;
+        return r;
+    default:
+        return NULL;
+    }
+}
+
+BinopNode::Helper BinopNode::helper()
+{
+    if(op()->attr() != AT_EXP || constOperand()) return HELPER_NONE;
+    switch(resultType()) {
+    case TP_INT:    return HELPER_INT_POW;
+    case TP_REAL:   return HELPER_REAL_POW;
+    default:        return HELPER_NONE;
+    }
+}
+
+void BinopNode::genReduced(TokNode *k, IrCode &ir)
+{
+    int64_t n = k->num().i;
+    switch(op()->attr()) {
+    case AT_MULT:
+        ir.pushInt(topBit(n));
+        ir.op(IR_LSHIFT);
+        break;
+    case AT_DIV:
+        ir.pushInt(topBit(n));
+        ir.op(IR_ARSHIFT);
+        break;
+    case AT_MOD:
+        ir.pushInt(n - 1);
+        ir.op(IR_AND);
+        break;
+    case AT_EXP:
+        if(resultType() == TP_REAL) {
+            // x x^i -> x x^i+1, leaving x^n
+            if(n == 1) break;
+            ir.op(IR_FDUP);
+            if(n == 2) {
+                ir.op(IR_FMUL);
+                break;
+            }
+            for(int64_t i = 1; i < n; i++) {
+                ir.op(IR_FOVER);
+                ir.op(IR_FMUL);
+            }
+            ir.op(IR_FNIP);
+        }
+        else if((n & (n - 1)) == 0) {
+            for(int i = topBit(n); i > 0; i--) {
+                ir.op(IR_DUP);
+                ir.op(IR_MUL);
+            }
+        }
+        else {
+            // left to right through the bits of n, keeping x below
+            ir.op(IR_DUP);
+            for(int i = topBit(n) - 1; i >= 0; i--) {
+                ir.op(IR_DUP);
+                ir.op(IR_MUL);
+                if(n >> i & 1) {
+                    ir.op(IR_OVER);
+                    ir.op(IR_MUL);
+                }
+            }
+            ir.op(IR_NIP);
+        }
+        break;
+    default:
+        assert(0);
+        break;
+    }
+}
+
+/********************************************************
+ ProgramNode
+********************************************************/
+
+/*
+    finds the helpers of the operators that are generated: those still
+    in the tree once it is folded, outside the bodies that are left out
+*/
+struct HelperFinder
+{
+    unsigned helpers;
+
+    Node *step(Node *node, int step, int, int &)
+    {
+        if(FunctionNode::is(node->kind())) {
+            #ifdef ENABLE_FUNCTIONS
+            FunctionNode *f = nodeCast<FunctionNode>(node);
+            if(step == 0 && f->bodyNeeded()) return f->body();
+            #endif
+            return NULL;
+        }
+        if(step == 0 && BinopNode::is(node->kind()))
+            helpers |= nodeCast<BinopNode>(node)->helper();
+        return step < node->childCount() ? node->child(step) : NULL;
+    }
+};
+
+void ProgramNode::reduceStrength()
+{
+    HelperFinder finder{0};
+    walkTree(this, 0, finder);
+    helpers = finder.helpers;
+}
+
+/*
+    the bodies of the helper words, between : and ;. The argument is the
+    value of an IR_PUSH_INT or IR_PUSH_REAL and the indent of an IR_LINE
+*/
+struct HelperOp
+{
+    IrOp op;
+    int arg;
+};
+
+// ( x n -- x^n ) keeps r x n, multiplying r by x for each set bit of n
+// as it squares x and shifts n right
+static const HelperOp intPow[] = {
+    {IR_LINE, 1}, {IR_PUSH_INT, 1}, {IR_MINUS_ROT, 0}, 
+    {IR_BEGIN, 0}, {IR_DUP, 0}, {IR_ZERO_GT, 0}, {IR_WHILE, 0},
+    {IR_LINE, 2}, {IR_DUP, 0}, {IR_PUSH_INT, 1}, {IR_AND, 0}, {IR_IF, 0},
+    {IR_ROT, 0}, {IR_PUSH_INT, 2}, {IR_PICK, 0}, {IR_MUL, 0}, 
+    {IR_MINUS_ROT, 0}, {IR_THEN, 0},
+    {IR_LINE, 2}, {IR_PUSH_INT, 1}, {IR_RSHIFT, 0}, {IR_SWAP, 0}, 
+    {IR_DUP, 0}, {IR_MUL, 0}, {IR_SWAP, 0},
+    {IR_LINE, 1}, {IR_REPEAT, 0}, {IR_2DROP, 0}
+};
+
+// ( n -- ) ( F: x -- x^n ) the same, with r x on the float stack
+static const HelperOp realPow[] = {
+    {IR_LINE, 1}, {IR_PUSH_REAL, 1}, {IR_FSWAP, 0},
+    {IR_BEGIN, 0}, {IR_DUP, 0}, {IR_ZERO_GT, 0}, {IR_WHILE, 0},
+    {IR_LINE, 2}, {IR_DUP, 0}, {IR_PUSH_INT, 1}, {IR_AND, 0}, {IR_IF, 0},
+    {IR_FSWAP, 0}, {IR_FOVER, 0}, {IR_FMUL, 0}, {IR_FSWAP, 0}, 
+    {IR_THEN, 0},
+    {IR_LINE, 2}, {IR_PUSH_INT, 1}, {IR_RSHIFT, 0}, {IR_FDUP, 0}, 
+    {IR_FMUL, 0},
+    {IR_LINE, 1}, {IR_REPEAT, 0}, {IR_DROP, 0}, {IR_FDROP, 0}
+};
+
+template<size_t N>
+static void genHelper(IrCode &ir, const char *name, const HelperOp (&body)[N])
+{
+    ir.named(IR_DEFINE, name);
+    for(const HelperOp &h : body) {
+        switch(h.op) {
+        case IR_PUSH_INT:   ir.pushInt(h.arg); break;
+        case IR_PUSH_REAL:  ir.pushReal(h.arg); break;
+        case IR_LINE:       ir.line(h.arg); break;
+        default:            ir.op(h.op); break;
+        }
+    }
+    ir.op(IR_END);
+    ir.line(0);
+}
+
+void ProgramNode::genHelpers(IrCode &ir)
+{
+    if(helpers & BinopNode::HELPER_INT_POW) genHelper(ir, "int-pow", intPow);
+    if(helpers & BinopNode::HELPER_REAL_POW) genHelper(ir, "real-pow", realPow);
+}
@@ -0,0 +1,320 @@
+#include <parser/newnodes.h>
+#include <generator/generator.h>
+#include <parser/walk.h>
+#include <assert.h>
+
+/*
+    the type checker. check() works out the type of every node below
+    the one it is called on, records it with setType() and reports the
+    first type or context error with a GenException. The generator then
+    reads the recorded types. Names must have been resolved first; see
+    resolveNames()
+
+    the tree is walked without recursion by calling checkStep() on each
+    node, which by the time it runs a step has the types of the
+    children it returned before.
+*/
+
+struct TypeChecker
+{
+    Node *step(Node *node, int step, int ctx, int &childCtx)
+    {
+        Context child = Context(ctx);
+        Node *next = node->checkStep(step, Context(ctx), child);
+        childCtx = child;
+        return next;
+    }
+};
+
+void Node::check(Context ctx)
+{
+    TypeChecker checker;
+    walkTree(this, ctx, checker);
+}
+
+Node *Node::checkStep(int step, Context, Context &)
+{
+    return step < childCount() ? child(step) : NULL;
+}
+
+/********************************************************
+ Statements
+********************************************************/
+
+Node *LetNode::checkStep(int, [[maybe_unused]] Context ctx, Context &)
+{
+#ifdef ENABLE_FUNCTIONS
+    if(ctx == CTX_OUTSIDE_FUNC)
+        error("let statements cannot be used outside functions");
+#endif
+    return NULL;
+}
+
+Node *PrintNode::checkStep(int step, Context, Context &)
+{
+    return step == 0 ? oper() : NULL;
+}
+
+Node *IfNode::checkStep(int step, [[maybe_unused]] Context ctx, Context &)
+{
+    switch(step) {
+    case 0:
+        #ifdef ENABLE_FUNCTIONS
+            if(ctx == CTX_OUTSIDE_FUNC)
+                error("if statements only allowed in functions");
+        #endif
+        return condExpr();
+    case 1:
+        if(condExpr()->resultType() != TP_BOOL)
+            typeError(std::string("expected bool condition in if statement"));
+        return thenExpr();
+    case 2:
+        return elseExpr();
+    default:
+        return NULL;
+    }
+}
+
+Node *WhileNode::checkStep(int step, [[maybe_unused]] Context ctx, Context &)
+{
+    switch(step) {
+    case 0:
+        #ifdef ENABLE_FUNCTIONS
+            if(ctx == CTX_OUTSIDE_FUNC)
+                error("while statements only allowed in functions");
+        #endif
+        return condExpr();
+    case 1:
+        if(condExpr()->resultType() != TP_BOOL)
+            typeError(std::string("expected bool condition in while loop"));
+        return bodyList();
+    default:
+        return NULL;
+    }
+}
+
+Node *FunctionNode::checkStep([[maybe_unused]] int step,
+                                [[maybe_unused]] Context ctx,
+                                [[maybe_unused]] Context &childCtx)
+{
+    #ifdef ENABLE_FUNCTIONS
+    childCtx = CTX_INSIDE_FUNC;
+    switch(step) {
+    case 0:
+        if(ctx == CTX_INSIDE_FUNC)
+            error("nested functions not allowed");
+        return bodyChecked() ? body() : NULL;
+    case 1:
+        // the return value
+        return idlist()->item(0);
+    default:
+        return NULL;
+    }
+    #else
+    return NULL;
+    #endif
+}
+
+/********************************************************
+ AssignNode
+********************************************************/
+
+Type AssignNode::typeCheck(Type ltype, Type rtype)
+{
+    if(ltype == TP_REAL) {
+        if(rtype == TP_REAL || rtype == TP_INT ) return TP_REAL;
+        typeError("expected numeric rvalue");
+    }
+    if(ltype == TP_INT) {
+        if(rtype == TP_INT) return TP_INT;
+        typeError("expected int rvalue");
+    }
+    if(ltype == TP_BOOL) {
+        if(rtype == TP_BOOL) return TP_BOOL;
+        typeError("expected bool rvalue");
+    }
+    if(ltype == TP_STR) {
+        if(rtype == TP_STR) return TP_STR;
+        typeError("expected str rvalue");
+    }
+    assert(0 && "we should not be here");
+}
+
+Node *AssignNode::checkStep(int step, Context, Context &)
+{
+    if(step == 0) return oper();
+
+    // verify that left and right types are compatible
+    setType(typeCheck(id()->binding().type, oper()->resultType()));
+    return NULL;
+}
+
+/********************************************************
+ BinopNode
+********************************************************/
+
+Type BinopNode::typeCheckBoolOp(Type l, Type r)
+{
+    if(l == TP_BOOL && r == TP_BOOL)        return TP_BOOL;
+    binopError(std::string("expected bool operands to binary ") +
+               opString(), l, r);
+}
+
+Type BinopNode::typeCheckCompareOp(Type l, Type r)
+{
+    if((l == TP_REAL || l == TP_INT) &&
+       (r == TP_REAL || r == TP_INT))       return TP_BOOL;
+    binopError(std::string("expected numeric operands to binary ") +
+              opString(), l, r);
+}
+
+Type BinopNode::typeCheckNumOp(Type l, Type r)
+{
+    if(l == TP_REAL || r == TP_REAL) {
+        if((l == TP_REAL || l == TP_INT) &&
+           (r == TP_REAL || r == TP_INT))   return TP_REAL;
+        binopError(std::string("expected numeric operands to binary ") +
+                   opString(), l, r);
+    }
+    if(l == TP_INT && r == TP_INT)          return TP_INT;
+    binopError(std::string("expected numeric operands to binary ") +
+              opString(), l, r);
+}
+
+Type BinopNode::typeCheckExpOp(Type l, Type r)
+{
+    if(l == TP_INT && r == TP_INT)          return TP_INT;
+    if(l == TP_REAL && r == TP_INT)         return TP_REAL;
+    binopError(std::string("expected numeric left arg and int right arg to binary ") +
+               opString(), l, r); 
+}
+
+Type BinopNode::typeCheck(Type l, Type r)
+{
+    switch(op()->attr()) {
+    case AT_PLUS:
+        if(l == TP_STR && r == TP_STR) return TP_STR;
+        return typeCheckNumOp(l, r);
+        break;
+    case AT_MINUS:
+    case AT_MULT:
+    case AT_DIV:
+    case AT_MOD:
+        return typeCheckNumOp(l, r); 
+        break;
+    case AT_EXP:
+        return typeCheckExpOp(l, r);
+        break;
+    case AT_LT:
+    case AT_LE:
+    case AT_GT:
+    case AT_GE:
+    case AT_EQ:
+    case AT_NE:
+        return typeCheckCompareOp(l, r);
+        break;
+    case AT_AND:
+    case AT_OR:
+        return typeCheckBoolOp(l, r);
+        break;
+    default: assert(0); break;
+    }
+}
+
+Node *BinopNode::checkStep(int step, Context, Context &)
+{
+    if(step == 0) return left();
+    if(step == 1) return right();
+    setType(typeCheck(left()->resultType(), right()->resultType()));
+    return NULL;
+}
+
+/********************************************************
+ UnopNode
+********************************************************/
+
+Type UnopNode::typeCheck(Type l)
+{
+    switch(op()->attr()) {
+    case AT_NOT:
+        if(l == TP_BOOL)    return TP_BOOL;
+        unopError(std::string("expected bool operand to unary not"), l);
+        break;
+    case AT_MINUS:
+        if(l == TP_INT)     return TP_INT;
+        if(l == TP_REAL)    return TP_REAL;
+        unopError(std::string("expected numeric operand to unary -"), l);
+    case AT_SIN:
+    case AT_COS:
+    case AT_TAN:
+        if(l == TP_REAL || l == TP_INT) return TP_REAL;
+        unopError(std::string("expected numeric operand to unary ") + 
+                  opString(), l);
+    default:
+        assert(0 && "unhandled unary operator in switch case");
+        break;
+    }
+}
+
+Node *UnopNode::checkStep(int step, Context, Context &)
+{
+    if(step == 0) return left();
+    setType(typeCheck(left()->resultType()));
+    return NULL;
+}
+
+/********************************************************
+ CallNode
+******************************************************/
+
+void CallNode::typeCheck(SymbolData &dat, int paramIndex, Type paramType)
+{
+   if(paramType != dat.paramType[paramIndex]) {
+        std::ostringstream str;
+        str << "arg #" << paramIndex+1 << " has type " << typeString(paramType) <<
+            " but function expects " << typeString(dat.paramType[paramIndex]);
+        typeError(str.str());
+   }
+}
+
+Node *CallNode::checkStep(int step, Context, Context &)
+{
+    SymbolData &dat = funcId()->binding();
+    if(step == 0 && dat.paramCount != paramCount())
+        error("wrong number of args to function");
+
+    // in the order the generator pushes them: step k follows the
+    // parameter paramCount()-k
+    if(step > 0) {
+        int i = paramCount() - step;
+        typeCheck(dat, i, param(i)->resultType());
+    }
+    if(step < paramCount()) return param(paramCount() - 1 - step);
+
+    setType(dat.type);
+    return NULL;
+}
+
+/********************************************************
+ TokNode
+********************************************************/
+
+Node *TokNode::checkStep(int, Context, Context &)
+{
+    if(token.name == TK_ID) {
+        setType(binding().type);
+        return NULL;
+    }
+
+    switch(token.attr) {
+    case AT_INT_OCT:
+    case AT_INT_HEX:
+    case AT_INT_DEC:    setType(TP_INT); break;
+    case AT_REAL:       setType(TP_REAL); break;
+    case AT_T:
+    case AT_F:          setType(TP_BOOL); break;
+    case AT_STR:        setType(TP_STR); break;
+    default:            break;
+    }
+    return NULL;
+}
@@ -0,0 +1,124 @@
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+/*
+	a bump allocator. Memory is carved out of large blocks and is never
+	freed piecemeal: objects allocated from an Arena are not destroyed,
+	and everything goes away at once when the arena is reset or
+	destroyed. Only objects that need no destructor (or whose destructor
+	may be skipped) should be placed here.
+*/
+class Arena
+{
+	static constexpr size_t FIRST_BLOCK = 64 * 1024;
+
+	struct Block
+	{
+		Block *next;
+		size_t size;
+	};
+
+	Block *blocks;
+	char *ptr;
+	char *end;
+
+	// allocates a new block large enough for 'size' bytes at 'align'.
+	// block sizes double, so a tree of n nodes needs O(log n) blocks
+	void *grow(size_t size, size_t align)
+	{
+		size_t blocksize = blocks ? blocks->size * 2 : FIRST_BLOCK;
+		while(blocksize < size + align + sizeof(Block))
+			blocksize *= 2;
+
+		Block *b = static_cast<Block *>(std::malloc(blocksize));
+		if(!b) throw std::bad_alloc();
+		b->next = blocks;
+		b->size = blocksize;
+		blocks = b;
+		ptr = reinterpret_cast<char *>(b + 1);
+		end = reinterpret_cast<char *>(b) + blocksize;
+		return allocate(size, align);
+	}
+
+	void freeBlocks(Block *b)
+	{
+		while(b) {
+			Block *next = b->next;
+			std::free(b);
+			b = next;
+		}
+	}
+
+public:
+	Arena() :
+		blocks(NULL),
+		ptr(NULL),
+		end(NULL)
+	{}
+
+	~Arena() {freeBlocks(blocks); }
+
+	Arena(const Arena &) = delete;
+	Arena &operator =(const Arena &) = delete;
+
+	inline void *allocate(size_t size,
+	                      size_t align = alignof(std::max_align_t))
+	{
+		char *p = reinterpret_cast<char *>(
+			(reinterpret_cast<size_t>(ptr) + align - 1) & ~(align - 1));
+		if(!ptr || p + size > end) return grow(size, align);
+		ptr = p + size;
+		return p;
+	}
+
+	/*
+		takes over every block of 'other', which is left empty. Objects
+		allocated from 'other' now live as long as this arena.
+	*/
+	void adopt(Arena &other)
+	{
+		if(!other.blocks) return;
+		if(!blocks) {
+			blocks = other.blocks;
+			ptr = other.ptr;
+			end = other.end;
+		}
+		else {
+			// keep allocating from our own current block
+			Block *last = other.blocks;
+			while(last->next) last = last->next;
+			last->next = blocks->next;
+			blocks->next = other.blocks;
+		}
+		other.blocks = NULL;
+		other.ptr = other.end = NULL;
+	}
+
+	/*
+		releases everything allocated from the arena. The largest block
+		is kept so that the next compile can reuse it without going back
+		to malloc. After adopt() that need not be the most recent one.
+	*/
+	void reset()
+	{
+		if(!blocks) return;
+		Block **largest = &blocks;
+		for(Block **b = &blocks->next; *b; b = &(*b)->next)
+			if((*b)->size > (*largest)->size) largest = b;
+
+		Block *keep = *largest;
+		*largest = keep->next;
+		freeBlocks(blocks);
+		keep->next = NULL;
+		blocks = keep;
+		ptr = reinterpret_cast<char *>(keep + 1);
+		end = reinterpret_cast<char *>(keep) + keep->size;
+	}
+};
+
+#endif
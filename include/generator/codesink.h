@@ -0,0 +1,103 @@
+#ifndef CODESINK_H
+#define CODESINK_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+// 'n' tabs, written from a table; see CodeSink
+struct Indent
+{
+	int n;
+
+	explicit Indent(int n) :
+		n(n)
+	{}
+};
+
+/*
+	collects generated code in memory and writes it out in one go. The
+	code is appended to a list of large chunks, so nothing is ever
+	copied twice, and writeTo() hands all of them to the kernel with
+	writev(). There is no flushing along the way.
+*/
+class CodeSink
+{
+	static constexpr size_t CHUNK_SIZE = 1 << 20;
+
+	struct Chunk
+	{
+		std::unique_ptr<char[]> data;
+		size_t used;
+	};
+
+	std::vector<Chunk> chunks;
+	char *cur;
+	char *end;
+
+	// starts a new chunk with room for at least 'n' bytes
+	void grow(size_t n);
+
+	// the used part of the last chunk
+	void close()
+	{
+		if(!chunks.empty()) chunks.back().used = cur - chunks.back().data.get();
+	}
+
+public:
+	CodeSink() :
+		chunks(),
+		cur(NULL),
+		end(NULL)
+	{}
+
+	CodeSink(const CodeSink &) = delete;
+	CodeSink &operator =(const CodeSink &) = delete;
+
+	inline void write(const char *s, size_t n)
+	{
+		if(size_t(end - cur) < n) grow(n);
+		memcpy(cur, s, n);
+		cur += n;
+	}
+
+	inline CodeSink &operator <<(char c)
+	{
+		if(cur == end) grow(1);
+		*cur++ = c;
+		return *this;
+	}
+
+	inline CodeSink &operator <<(std::string_view s)
+	{
+		write(s.data(), s.size());
+		return *this;
+	}
+
+	inline CodeSink &operator <<(const char *s)
+	{
+		return *this << std::string_view(s);
+	}
+
+	inline CodeSink &operator <<(const std::string &s)
+	{
+		return *this << std::string_view(s);
+	}
+
+	CodeSink &operator <<(int64_t i);
+	CodeSink &operator <<(Indent tabs);
+
+	// the number of bytes collected so far
+	size_t size();
+
+	/*
+		writes everything collected to 'fd' and empties the sink.
+		Returns false, with errno set, if a write failed.
+	*/
+	bool writeTo(int fd);
+};
+
+#endif
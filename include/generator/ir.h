@@ -0,0 +1,164 @@
+#ifndef IR_H
+#define IR_H
+
+#include <generator/codesink.h>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+/*
+	the ops of the stack machine code the generator produces. Most are
+	one gforth word; the comments name the word where it is not obvious
+	and the pool an op's argument indexes, if it has one.
+
+	int division is floored. gforth's / and mod are floored or
+	symmetric depending on how it was built, so IR_DIV and IR_MOD are
+	printed with fm/mod, which is always floored.
+*/
+enum IrOp : uint8_t {
+	// constants and locals
+	IR_PUSH_INT,	// ints
+	IR_PUSH_REAL,	// reals
+	IR_PUSH_STR,	// names: the literal's lexeme, quotes included
+	IR_TRUE,
+	IR_FALSE,
+	IR_LOAD,	// names: push a local
+	IR_STORE,	// names: TO a local
+	IR_LOCAL_W,	// names: a cell local, { W: x }
+	IR_LOCAL_F,	// names: a float local, { F: x }
+	IR_LOCAL_D,	// names: a double cell local, { D: x }
+
+	// ints and flags
+	IR_ADD,
+	IR_SUB,
+	IR_MUL,
+	IR_DIV,		// floored, whichever way gforth's / rounds
+	IR_MOD,		// floored, with the sign of the divisor
+	IR_NEGATE,
+	IR_LSHIFT,
+	IR_RSHIFT,
+	IR_ARSHIFT,
+	IR_AND,
+	IR_OR,
+	IR_INVERT,
+	IR_LT,
+	IR_LE,
+	IR_GT,
+	IR_GE,
+	IR_EQ,
+	IR_NE,		// <>
+	IR_ZERO_EQ,	// 0=
+	IR_ZERO_LT,	// 0<
+	IR_ZERO_GT,	// 0>
+
+	// reals
+	IR_S_TO_F,	// s>f
+	IR_FADD,
+	IR_FSUB,
+	IR_FMUL,
+	IR_FDIV,
+	IR_FMOD,
+	IR_FNEGATE,
+	IR_FSIN,
+	IR_FCOS,
+	IR_FTAN,
+	IR_FLT,
+	IR_FLE,
+	IR_FGT,
+	IR_FGE,
+	IR_FEQ,
+	IR_FNE,
+
+	// stack
+	IR_DUP,
+	IR_DROP,
+	IR_2DROP,
+	IR_SWAP,
+	IR_OVER,
+	IR_NIP,
+	IR_ROT,
+	IR_MINUS_ROT,	// -rot
+	IR_PICK,
+	IR_FDUP,
+	IR_FDROP,
+	IR_FSWAP,
+	IR_FOVER,
+	IR_FNIP,
+
+	// output
+	IR_PRINT,	// .
+	IR_FPRINT,	// f.
+	IR_TYPE,
+
+	// control
+	IR_IF,
+	IR_ELSE,
+	IR_THEN,
+	IR_BEGIN,
+	IR_WHILE,
+	IR_REPEAT,
+	IR_SCOPE,
+	IR_ENDSCOPE,
+	IR_CALL,	// names
+	IR_DEFINE,	// names: starts the word, :
+	IR_END,		// ends it, ;
+	IR_BYE,
+
+	// layout: the next op starts a line indented by 'arg' tabs
+	IR_LINE
+};
+
+struct IrInst
+{
+	IrOp op;
+	uint32_t arg;
+};
+
+/*
+	a linear sequence of stack machine ops, lowered from the tree by
+	Node::generate() and printed by emitGforth(). Instructions are a
+	fixed 8 bytes; literals and names are kept in pools the argument
+	indexes. Names are views, so they must outlive the code: the
+	generator only uses names held by the tree and the input.
+*/
+class IrCode
+{
+	inline void add(IrOp op, uint32_t arg)
+	{
+		code.push_back(IrInst{op, arg});
+	}
+
+public:
+	std::vector<IrInst> code;
+	std::vector<int64_t> ints;
+	std::vector<double> reals;
+	std::vector<std::string_view> names;
+
+	inline void op(IrOp op) {add(op, 0); }
+
+	inline void pushInt(int64_t i)
+	{
+		add(IR_PUSH_INT, ints.size());
+		ints.push_back(i);
+	}
+
+	inline void pushReal(double r)
+	{
+		add(IR_PUSH_REAL, reals.size());
+		reals.push_back(r);
+	}
+
+	// for the ops whose argument is a name
+	inline void named(IrOp op, std::string_view name)
+	{
+		add(op, names.size());
+		names.push_back(name);
+	}
+
+	inline void line(int indent) {add(IR_LINE, indent); }
+};
+
+// prints 'ir' as gforth source
+void emitGforth(const IrCode &ir, CodeSink &out);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <parser/newnodes.h>
+#include <string>
+#include <vector>
+
+/*
+    binds every identifier in the tree to its declaration, which is
+    stored once in Ast::symbols with its type and the name the gforth
+    code uses for it (see TokNode::binding()). The generator then needs
+    no symbol table lookups.
+
+    scopes are followed exactly as the generator enters them. Every
+    undeclared or redeclared name is reported, in program order, in
+    'errors', which is empty if the tree is fine. A lazy function body
+    that is needed is parsed here, and may throw ParseException.
+*/
+void resolveNames(ProgramNode *program, std::vector<std::string> &errors);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef BRACKETINDEX_H
+#define BRACKETINDEX_H
+
+#include <lexer/tokenbuffer.h>
+#include <vector>
+#include <cstdint>
+
+/*
+	the bracket structure of a TokenBuffer, found in one pass over the
+	token names before anything is parsed. IBTL is fully bracketed, so
+	this is enough to cut a program into independent subtrees.
+*/
+class BracketIndex
+{
+public:
+	enum : uint32_t {
+		NO_MATCH = UINT32_MAX
+	};
+
+	// for a bracket token, the index of its partner. NO_MATCH for other
+	// tokens and for brackets without a partner
+	std::vector<uint32_t> match;
+
+	// the number of lexemes of the tokens before each token, which is
+	// where a TokenCursor starting at that token reads its first lexeme
+	std::vector<uint32_t> lexemeAt;
+
+	// true if every bracket has a partner
+	bool balanced;
+
+	BracketIndex(TokenBuffer &tokens);
+};
+
+#endif
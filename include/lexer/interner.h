@@ -0,0 +1,46 @@
+
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include <lexer/token.h>
+#include <arena.h>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+/*
+	stores each distinct identifier once and numbers them densely from 0.
+	The lexer interns every identifier it reads, so later stages can
+	compare and look up names by SymbolId instead of by string.
+*/
+class Interner
+{
+	// copies of the interned names
+	Arena storage;
+
+	// indexed by SymbolId
+	std::vector<std::string_view> names;
+	std::vector<uint32_t> hashes;
+
+	// open addressing table of SymbolId + 1; 0 marks an empty slot
+	std::vector<uint32_t> slots;
+
+	static uint32_t hash(std::string_view s);
+	void grow();
+
+public:
+	Interner();
+
+	Interner(const Interner &) = delete;
+	Interner &operator =(const Interner &) = delete;
+
+	// returns the id of 's', adding it if it has not been seen before
+	SymbolId intern(std::string_view s);
+
+	// the returned view is valid for the lifetime of the Interner
+	inline std::string_view name(SymbolId id) {return names[id]; }
+
+	inline size_t size() {return names.size(); }
+};
+
+#endif
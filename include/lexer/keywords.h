@@ -0,0 +1,113 @@
+
+#ifndef KEYWORDS_H
+#define KEYWORDS_H
+
+#include <lexer/token.h>
+#include <string_view>
+#include <cstring>
+#include <cstddef>
+
+/*
+	keyword recognition. The keyword set is fixed, so it is looked up in
+	a perfect hash table built at compile time: one hash, one probe and
+	one compare per identifier, with no allocation.
+*/
+
+struct Keyword
+{
+	const char *text;
+	size_t len;
+	TokenName name;
+	TokenAttr attr;
+};
+
+constexpr Keyword keywords[] = {
+	{"if",		2,	TK_IF,		AT_NONE},
+	{"while",	5,	TK_WHILE,	AT_NONE},
+	{"let",		3,	TK_LET,		AT_NONE},
+	{"stdout",	6,	TK_PRINT,	AT_NONE},
+
+	{"bool",	4,	TK_TYPE,	AT_KBOOL},
+	{"int",		3,	TK_TYPE,	AT_KINT},
+	// TODO: verify these are correct type names
+	{"float",	5,	TK_TYPE,	AT_KREAL},
+	{"string",	6,	TK_TYPE,	AT_KSTR},
+
+	{"true",	4,	TK_CONSTANT,	AT_T},
+	{"false",	5,	TK_CONSTANT,	AT_F},
+
+	{"and",		3,	TK_BINOP,	AT_AND},
+	{"or",		2,	TK_BINOP,	AT_OR},
+	{"not",		3,	TK_UNOP,	AT_NOT},
+	{"sin",		3,	TK_UNOP,	AT_SIN},
+	{"cos",		3,	TK_UNOP,	AT_COS},
+	{"tan",		3,	TK_UNOP,	AT_TAN}
+};
+
+constexpr size_t KEYWORD_COUNT = sizeof(keywords) / sizeof(keywords[0]);
+constexpr size_t KEYWORD_MINLEN = 2;
+constexpr size_t KEYWORD_MAXLEN = 6;
+
+// must be a power of two
+constexpr size_t KEYWORD_TABLESIZE = 32;
+
+/*
+	the hash only looks at the length and the first and last characters.
+	The multiplier was picked so that the current keyword set does not
+	collide; keywordTableOk() below checks this at compile time.
+*/
+constexpr size_t keywordHash(const char *s, size_t len)
+{
+	return (len + (unsigned char)s[0] + (unsigned char)s[len-1] * 10) &
+		(KEYWORD_TABLESIZE - 1);
+}
+
+struct KeywordTable
+{
+	// index into 'keywords', or -1 for an empty slot
+	signed char slot[KEYWORD_TABLESIZE];
+	bool perfect;
+};
+
+constexpr KeywordTable makeKeywordTable()
+{
+	KeywordTable t = {};
+	t.perfect = true;
+	for(size_t i = 0; i < KEYWORD_TABLESIZE; i++)
+		t.slot[i] = -1;
+	for(size_t i = 0; i < KEYWORD_COUNT; i++) {
+		size_t h = keywordHash(keywords[i].text, keywords[i].len);
+		if(t.slot[h] != -1) t.perfect = false;
+		t.slot[h] = i;
+	}
+	return t;
+}
+
+constexpr KeywordTable keywordTable = makeKeywordTable();
+
+static_assert(keywordTable.perfect,
+              "keyword hash collides; pick a new multiplier in keywordHash()");
+
+/*
+	returns true if 'lexeme' is a keyword, in which case 'name' and 'attr'
+	describe the matching keyword token.
+*/
+inline bool lookupKeyword(std::string_view lexeme, TokenName &name, 
+                          TokenAttr &attr)
+{
+	size_t len = lexeme.size();
+	if(len < KEYWORD_MINLEN || len > KEYWORD_MAXLEN) return false;
+
+	int k = keywordTable.slot[keywordHash(lexeme.data(), len)];
+	if(k < 0) return false;
+
+	const Keyword &kw = keywords[k];
+	if(kw.len != len || std::memcmp(kw.text, lexeme.data(), len) != 0)
+		return false;
+
+	name = kw.name;
+	attr = kw.attr;
+	return true;
+}
+
+#endif
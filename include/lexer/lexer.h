@@ -5,26 +5,30 @@
 #include <sstream>
 #include <lexer/reader.h>
 #include <lexer/token.h>
-#include <symtable.h>
+#include <lexer/interner.h>
 
 class LexException : public std::exception
 {
 	std::string msg;
-	int line;
 public:
 	
+	LexException(const std::string &msg, int line) :
+		msg()
+	{
+		std::ostringstream str;
+		str << "line " << line << ": " << msg;
+		this->msg = str.str();
+	}
+
 	LexException(const std::string &msg, Reader &rd) :
-		msg(msg),
-		line(rd.getStartLine())
+		LexException(msg, rd.getStartLine())
 	{}
 
 	~LexException() throw() {}
 	
 	const char *what() const throw()
 	{
-		std::ostringstream str;
-		str << "line " << line << ": " << msg;
-		return str.str().c_str();
+		return msg.c_str();
 	}
 };
 
@@ -33,14 +37,18 @@ class Lexer
 public:
 
 	virtual Token getToken() = 0;
+
+	// the line number the parser reports for the last token returned
+	virtual int line() = 0;
 };
 
 
-class IBTLLexer : public Lexer
+class IBTLLexer final : public Lexer
 {
 private:
 	Reader &input;
-	SymbolTable &symTable;
+	Interner &names;
+	size_t tokOffset;
 
 public:
 	
@@ -50,20 +58,25 @@ public:
 	Token readId();
 	Token readString();
 	Token readNumber(char c);
+	void numberValue(Token &tok);
 	Token readRelop(char c);
 	Token readOp(char c);
 	void readWs();
 
 public:
-	IBTLLexer(Reader &input, SymbolTable &symTable) :
+	IBTLLexer(Reader &input, Interner &names) :
 		Lexer(),
 		input(input),
-		symTable(symTable)
+		names(names),
+		tokOffset(0)
 	{}
 
 	Token getToken();
 
 	int line() {return input.getStartLine(); }
+
+	// offset of the first character of the last token returned
+	size_t offset() {return tokOffset; }
 };
 
 
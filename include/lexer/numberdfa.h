@@ -0,0 +1,166 @@
+
+#ifndef NUMBERDFA_H
+#define NUMBERDFA_H
+
+#include <cstdint>
+
+/*
+	the DFA for numeric constants, as a transition table indexed by
+	(state, character class). The table is built at compile time from the
+	transitions listed in makeNumberDfa().
+
+	state names follow the original hand-written machine. The start state
+	q0 consumes the character that getToken() already read; every other
+	state reads one more character. Final states are reached on the
+	character after the constant, which the lexer puts back.
+*/
+
+enum NumClass : uint8_t {
+	NC_ZERO,		// 0
+	NC_OCT,			// 1-7
+	NC_DEC,			// 8-9
+	NC_HEX,			// a-f A-F, except e E
+	NC_E,			// e E
+	NC_X,			// x X
+	NC_DOT,
+	NC_SIGN,		// + -
+	NC_OTHER,
+	NC_COUNT
+};
+
+enum NumState : uint8_t {
+	NS_Q0,
+	NS_Q1,			// decimal digits that can only become a real
+	NS_Q2,			// fraction after digits and '.'
+	NS_Q3,			// leading '.'
+	NS_Q4,			// fraction after a leading '.'
+	NS_Q5,			// exponent marker
+	NS_Q6,			// exponent digits
+	NS_Q7,			// exponent sign
+	NS_Q10,			// 0x
+	NS_Q11,			// hex digits
+	NS_Q1_8,		// leading 0
+	NS_Q1_9,		// octal digits
+	NS_Q1_12,		// decimal digits
+
+	// final states
+	NS_ACCEPT_DEC,
+	NS_ACCEPT_OCT,
+	NS_ACCEPT_HEX,
+	NS_ACCEPT_REAL,
+	NS_REJECT,
+	NS_COUNT
+};
+
+constexpr int NS_FIRST_FINAL = NS_ACCEPT_DEC;
+
+struct NumberDfa
+{
+	uint8_t cls[256];
+	uint8_t next[NS_FIRST_FINAL][NC_COUNT];
+
+	// states that stay put on every digit. The lexer can skip a whole
+	// run of digits in these states at once
+	bool digitLoop[NS_FIRST_FINAL];
+};
+
+constexpr NumberDfa makeNumberDfa()
+{
+	NumberDfa d = {};
+
+	for(int c = 0; c < 256; c++) {
+		uint8_t k = NC_OTHER;
+		if(c == '0') k = NC_ZERO;
+		else if('1' <= c && c <= '7') k = NC_OCT;
+		else if(c == '8' || c == '9') k = NC_DEC;
+		else if(c == 'e' || c == 'E') k = NC_E;
+		else if(('a' <= c && c <= 'f') || ('A' <= c && c <= 'F')) k = NC_HEX;
+		else if(c == 'x' || c == 'X') k = NC_X;
+		else if(c == '.') k = NC_DOT;
+		else if(c == '+' || c == '-') k = NC_SIGN;
+		d.cls[c] = k;
+	}
+
+	// default transition of each state on a character it does not expect
+	const uint8_t otherwise[NS_FIRST_FINAL] = {
+		NS_REJECT,			// q0
+		NS_REJECT,			// q1
+		NS_ACCEPT_REAL,		// q2
+		NS_REJECT,			// q3
+		NS_ACCEPT_REAL,		// q4
+		NS_REJECT,			// q5
+		NS_ACCEPT_REAL,		// q6
+		NS_REJECT,			// q7
+		NS_REJECT,			// q10
+		NS_ACCEPT_HEX,		// q11
+		NS_ACCEPT_DEC,		// q1_8
+		NS_ACCEPT_OCT,		// q1_9
+		NS_ACCEPT_DEC		// q1_12
+	};
+	for(int s = 0; s < NS_FIRST_FINAL; s++)
+		for(int k = 0; k < NC_COUNT; k++)
+			d.next[s][k] = otherwise[s];
+
+	d.next[NS_Q0][NC_ZERO] = NS_Q1_8;
+	d.next[NS_Q0][NC_OCT] = NS_Q1_12;
+	d.next[NS_Q0][NC_DEC] = NS_Q1_12;
+	d.next[NS_Q0][NC_DOT] = NS_Q3;
+
+	d.next[NS_Q1][NC_ZERO] = d.next[NS_Q1][NC_OCT] = 
+		d.next[NS_Q1][NC_DEC] = NS_Q1;
+	d.next[NS_Q1][NC_DOT] = NS_Q2;
+
+	d.next[NS_Q2][NC_ZERO] = d.next[NS_Q2][NC_OCT] = 
+		d.next[NS_Q2][NC_DEC] = NS_Q2;
+	d.next[NS_Q2][NC_E] = NS_Q5;
+
+	d.next[NS_Q3][NC_ZERO] = d.next[NS_Q3][NC_OCT] = 
+		d.next[NS_Q3][NC_DEC] = NS_Q4;
+
+	d.next[NS_Q4][NC_ZERO] = d.next[NS_Q4][NC_OCT] = 
+		d.next[NS_Q4][NC_DEC] = NS_Q4;
+	d.next[NS_Q4][NC_E] = NS_Q5;
+
+	d.next[NS_Q5][NC_ZERO] = d.next[NS_Q5][NC_OCT] = 
+		d.next[NS_Q5][NC_DEC] = NS_Q6;
+	d.next[NS_Q5][NC_SIGN] = NS_Q7;
+
+	d.next[NS_Q6][NC_ZERO] = d.next[NS_Q6][NC_OCT] = 
+		d.next[NS_Q6][NC_DEC] = NS_Q6;
+
+	d.next[NS_Q7][NC_ZERO] = d.next[NS_Q7][NC_OCT] = 
+		d.next[NS_Q7][NC_DEC] = NS_Q6;
+
+	d.next[NS_Q10][NC_ZERO] = d.next[NS_Q10][NC_OCT] = 
+		d.next[NS_Q10][NC_DEC] = d.next[NS_Q10][NC_HEX] = 
+		d.next[NS_Q10][NC_E] = NS_Q11;
+
+	d.next[NS_Q11][NC_ZERO] = d.next[NS_Q11][NC_OCT] = 
+		d.next[NS_Q11][NC_DEC] = d.next[NS_Q11][NC_HEX] = 
+		d.next[NS_Q11][NC_E] = NS_Q11;
+
+	d.next[NS_Q1_8][NC_X] = NS_Q10;
+	d.next[NS_Q1_8][NC_ZERO] = d.next[NS_Q1_8][NC_OCT] = NS_Q1_9;
+	d.next[NS_Q1_8][NC_DEC] = NS_Q1;
+	d.next[NS_Q1_8][NC_DOT] = NS_Q2;
+	d.next[NS_Q1_8][NC_E] = NS_Q5;
+
+	d.next[NS_Q1_9][NC_ZERO] = d.next[NS_Q1_9][NC_OCT] = NS_Q1_9;
+	d.next[NS_Q1_9][NC_DEC] = NS_Q1;
+	d.next[NS_Q1_9][NC_DOT] = NS_Q2;
+	d.next[NS_Q1_9][NC_E] = NS_Q5;
+
+	d.next[NS_Q1_12][NC_ZERO] = d.next[NS_Q1_12][NC_OCT] = 
+		d.next[NS_Q1_12][NC_DEC] = NS_Q1_12;
+	d.next[NS_Q1_12][NC_DOT] = NS_Q2;
+	d.next[NS_Q1_12][NC_E] = NS_Q5;
+
+	for(int s = 0; s < NS_FIRST_FINAL; s++)
+		d.digitLoop[s] = d.next[s][NC_ZERO] == s && d.next[s][NC_OCT] == s &&
+		                 d.next[s][NC_DEC] == s;
+	return d;
+}
+
+constexpr NumberDfa numberDfa = makeNumberDfa();
+
+#endif
@@ -3,6 +3,34 @@
 #define READER_H
 
 #include <iostream>
+#include <string>
+#include <string_view>
+#include <deque>
+#include <cstddef>
+#include <lexer/scan.h>
+
+/*
+	maps a file read-only into memory. If the file is not a regular file
+	(a pipe, a tty, ...) or cannot be mapped, isMapped() returns false and
+	the caller should fall back to reading it through an istream.
+*/
+class MappedFile
+{
+	const char *addr;
+	size_t len;
+	bool mapped;
+
+public:
+	MappedFile(const std::string &filename);
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator =(const MappedFile &) = delete;
+
+	bool isMapped() {return mapped; }
+	const char *data() {return addr; }
+	size_t size() {return len; }
+};
 
 class Reader
 {
@@ -11,28 +39,97 @@ private:
 		BUFSIZE=4096
 	};
 
+	// istream backend
 	std::istream *in;
 	char charbuf;
 	bool charbuf_full;
 	bool quotemode;
 	char readbuf[BUFSIZE];
 	int pos;
+
+	// in-memory backend: the whole input is visible through 'data', and
+	// the current lexeme is data[start, cur). Both backends keep 'cur' 
+	// and 'start' as offsets into the input
+	bool mapped;
+	const char *data;
+	size_t size;
+	size_t cur;
+	size_t start;
+
+	// lexemes read through the istream backend are copied here so that
+	// the views handed out by keepLexeme() stay valid
+	std::deque<std::string> saved;
+
 	int line;
 	int startline;
+
+	const ScanKernels &scan;
+
+	char streamGetChar();
+	void streamPutChar();
 	
 public:
 	Reader(std::istream *in);
 
-	char getChar();
+	// reads directly from a buffer (usually a MappedFile) which must
+	// outlive the Reader and every token taken from it
+	Reader(const char *data, size_t size);
+
+	// reads data[begin, end) of a larger buffer, starting at line
+	// 'line'. Offsets are still counted from 'data'
+	Reader(const char *data, size_t begin, size_t end, int line);
+
+	inline char getChar()
+	{
+		if(!mapped) return streamGetChar();
 
-	void putChar();
+		char c = cur < size ? data[cur] : 0;
+		cur++;
+		if(c == '\n') line++;
+		return c;
+	}
 
-	const char *getLexeme();
+	inline void putChar()
+	{
+		if(!mapped) {
+			streamPutChar();
+			return;
+		}
+		cur--;
+		if(cur < size && data[cur] == '\n') line--;
+	}
+
+	/*
+		bulk scanning for the in-memory backend. Each call consumes a
+		run of characters of one class into the current lexeme, using
+		the vector kernels in scan.h. With the istream backend they do
+		nothing, and the lexer's getChar() loops do all the work.
+	*/
+	void skipSpace();
+	void skipIdent();
+	void skipDigits();
+	void skipString();		// stops at '"' or '\0'
+
+	/*
+		returns the current lexeme. The view is only valid until the
+		lexeme is cleared.
+	*/
+	std::string_view getLexeme();
+
+	/*
+		returns the current lexeme as a view that stays valid for the
+		lifetime of the Reader. With the in-memory backend this does
+		not copy.
+	*/
+	std::string_view keepLexeme();
 
 	void clearLexeme();
 
 	int getLine() {return line; }
 	int getStartLine() {return startline; }
+
+	// offset of the current lexeme from the beginning of the input
+	size_t getStartOffset() {return start; }
 };
 
 #endif
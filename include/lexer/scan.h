@@ -0,0 +1,68 @@
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <cstddef>
+
+/*
+	character classes of the lexer. These match the C locale versions of
+	std::isspace/std::isalnum/... without going through the locale.
+*/
+inline bool isSpaceChar(char c)
+{
+	return c == ' ' || (unsigned char)(c - '\t') <= '\r' - '\t';
+}
+
+inline bool isDigitChar(char c) {return (unsigned char)(c - '0') <= 9; }
+
+inline bool isAlphaChar(char c)
+{
+	return (unsigned char)((c | 0x20) - 'a') <= 'z' - 'a';
+}
+
+inline bool isIdChar(char c)
+{
+	return isAlphaChar(c) || isDigitChar(c) || c == '_';
+}
+
+/*
+	bulk scanning kernels over an in-memory input. Each takes the range
+	[p, end) and returns a pointer to the first character that ends the
+	run. Kernels that can cross lines add the number of '\n' characters
+	they skipped to 'lines'.
+*/
+struct ScanKernels
+{
+	// skips whitespace
+	const char *(*skipSpace)(const char *p, const char *end, int &lines);
+
+	// skips [A-Za-z0-9_]
+	const char *(*skipIdent)(const char *p, const char *end);
+
+	// skips [0-9]
+	const char *(*skipDigits)(const char *p, const char *end);
+
+	// skips the body of a string literal: stops at '"' or '\0'
+	const char *(*skipString)(const char *p, const char *end, int &lines);
+
+	size_t (*countNewlines)(const char *p, const char *end);
+
+	size_t (*countQuotes)(const char *p, const char *end);
+};
+
+enum ScanLevel {
+	SCAN_SCALAR,
+	SCAN_SSE2,
+	SCAN_AVX2
+};
+
+// the best level the running cpu supports
+ScanLevel bestScanLevel();
+
+// the kernels for 'level', which must be supported by the cpu
+const ScanKernels &scanKernels(ScanLevel level);
+
+// the kernels for bestScanLevel(), chosen once at startup
+const ScanKernels &scanKernels();
+
+#endif
@@ -4,12 +4,24 @@
 
 #include <unordered_map> // c++11 only
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <sstream>
+#include <cstdint>
 
 
 struct Token;
 
+// identifiers are numbered by the Interner
+typedef uint32_t SymbolId;
+
+// the value of a numeric constant: 'i' for ints, 'r' for reals
+union NumValue
+{
+	int64_t i;
+	double r;
+};
+
 enum TokenName {
 	TK_EOF = 0,
 
@@ -77,52 +89,46 @@ struct Token
 {
 	TokenName 	name;
 	TokenAttr 	attr;
-	std::string 	val;
+
+	// the lexeme of ids and literals. This is a view into the input
+	// held by the Reader, so tokens are cheap to copy but must not
+	// outlive the Reader they came from
+	std::string_view	val;
+
+	// for TK_ID tokens, the interned id of the identifier
+	SymbolId	sym;
+
+	// for int and real constants, the value computed by the lexer
+	NumValue	num;
 
 	// for tokens that store a lexeme value
-	Token(const char *val, TokenName name, TokenAttr attr = AT_NONE) :
+	Token(std::string_view val, TokenName name, TokenAttr attr = AT_NONE) :
 		name(name),
 		attr(attr),
-		val(val)
+		val(val),
+		sym(0),
+		num()
 	{}
 
 	// for tokens that do not store a lexeme value
 	Token(TokenName name, TokenAttr attr = AT_NONE) :
 		name(name),
 		attr(attr),
-		val()
+		val(),
+		sym(0),
+		num()
 	{}
 
 	Token() :
 		name(),
 		attr(),
-		val()
-	{}
-
-	/*
-		the 'val' field of a token can consume a lot of space. The
-		move ctor ensures that only the underlying pointer to the 
-		string (and not the string itself) is copied when a token
-		is moved
-
-		Note: when a non-temporary Token is copied, we still need 
-		a deep copy of the 'val' field
-	*/
-	Token(Token &&other) :
-		name(other.name),
-		attr(other.attr),
-		val(std::move(other.val))
+		val(),
+		sym(0),
+		num()
 	{}
 
-	Token &operator =(Token &&other)
-	{
-		name = other.name;
-		attr = other.attr;
-		val = std::move(other.val);
-	}
-
 
-	static std::string nameToString(TokenName name)
+	static const char *nameToString(TokenName name)
 	{
 		switch(name) {
 		case TK_EOF: return "eof";
@@ -143,7 +149,7 @@ struct Token
 		}
 	}
 
-	static std::string attrToString(TokenAttr attr)
+	static const char *attrToString(TokenAttr attr)
 	{
 		switch(attr) {
 		case AT_STR: return "str";
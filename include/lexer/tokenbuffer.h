@@ -0,0 +1,128 @@
+
+#ifndef TOKENBUFFER_H
+#define TOKENBUFFER_H
+
+#include <lexer/lexer.h>
+#include <lexer/token.h>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+/*
+	a whole input, tokenized up front and stored as a structure of
+	arrays. Most IBTL tokens are brackets and operators, so a token costs
+	two bytes of name/attr plus its source offset and line. Only ids and
+	literals have an entry in the out-of-line lexeme table, which is
+	consumed in token order.
+*/
+class TokenBuffer
+{
+public:
+	struct Lexeme
+	{
+		std::string_view val;
+		union {
+			SymbolId sym;	// ids
+			NumValue num;	// numeric constants
+		};
+	};
+
+	std::vector<uint8_t> names;		// TokenName
+	std::vector<uint8_t> attrs;		// TokenAttr
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> lines;	// Lexer::line() after each token
+
+	std::vector<Lexeme> lexemes;
+
+	// offsets, and token positions elsewhere, are 32 bits, so inputs of
+	// 4GiB or more are rejected
+	static constexpr size_t MAX_OFFSET = UINT32_MAX;
+
+	// true if tokens named 'name' with attribute 'attr' carry a lexeme
+	static inline bool hasLexeme(TokenName name, TokenAttr attr)
+	{
+		return name == TK_ID || 
+		       (name == TK_CONSTANT && attr != AT_T && attr != AT_F);
+	}
+
+	inline size_t size() {return names.size(); }
+
+	/*
+		appends every token of 'lexer' up to and including TK_EOF.
+		Throws LexException like IBTLLexer::getToken(), or once the
+		input passes MAX_OFFSET.
+	*/
+	void fill(IBTLLexer &lexer);
+
+	/*
+		appends the tokens of the in-memory input data[0, size), lexed
+		in chunks on up to 'threads' threads. The result is the same as
+		fill() with an IBTLLexer over the whole input: same tokens,
+		lines and offsets, and identifiers interned into 'interner' in
+		the same order. Throws the LexException that fill() would throw,
+		before lexing anything if 'size' is over MAX_OFFSET.
+	*/
+	void fillParallel(const char *data, size_t size, Interner &interner,
+	                  unsigned threads);
+};
+
+
+/*
+	feeds the tokens of a TokenBuffer to the parser. Once the end of the
+	buffer is reached, TK_EOF is returned indefinitely, like IBTLLexer.
+*/
+class TokenCursor final : public Lexer
+{
+	TokenBuffer &buf;
+	size_t pos;		// next token
+	size_t lex;		// next lexeme
+	int curLine;
+
+public:
+	TokenCursor(TokenBuffer &buf) :
+		Lexer(),
+		buf(buf),
+		pos(0),
+		lex(0),
+		curLine(1)
+	{}
+
+	// starts at token 'pos', whose first lexeme is lexemes['lex']
+	TokenCursor(TokenBuffer &buf, size_t pos, size_t lex) :
+		Lexer(),
+		buf(buf),
+		pos(pos),
+		lex(lex),
+		curLine(1)
+	{}
+
+	Token getToken()
+	{
+		Token t((TokenName)buf.names[pos], (TokenAttr)buf.attrs[pos]);
+		if(TokenBuffer::hasLexeme(t.name, t.attr)) {
+			const TokenBuffer::Lexeme &l = buf.lexemes[lex++];
+			t.val = l.val;
+			if(t.name == TK_ID) t.sym = l.sym;
+			else t.num = l.num;
+		}
+		curLine = buf.lines[pos];
+		if(pos + 1 < buf.size()) pos++;
+		return t;
+	}
+
+	int line() {return curLine; }
+
+	// the next token getToken() will return, and its first lexeme
+	size_t position() {return pos; }
+	size_t lexemePosition() {return lex; }
+
+	void seek(size_t pos, size_t lex)
+	{
+		this->pos = pos;
+		this->lex = lex;
+	}
+
+	TokenBuffer &buffer() {return buf; }
+};
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef TOKENRING_H
+#define TOKENRING_H
+
+#include <lexer/lexer.h>
+#include <lexer/token.h>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+/*
+	a bounded single-producer/single-consumer queue. 'head' is only
+	written by the consumer and 'tail' only by the producer; each side
+	keeps a private copy of the other's index and reloads it only when
+	the ring looks full (or empty), so the shared cache lines move
+	between cores once per batch rather than once per item.
+*/
+template<class T>
+class SpscRing
+{
+	static constexpr size_t LINE = 64;
+
+	// consumer side
+	alignas(LINE) std::atomic<size_t> head;
+	size_t tailCache;
+
+	// producer side
+	alignas(LINE) std::atomic<size_t> tail;
+	size_t headCache;
+
+	alignas(LINE) std::vector<T> slots;
+	size_t mask;
+
+public:
+	// 'capacity' must be a power of two
+	SpscRing(size_t capacity) :
+		head(0),
+		tailCache(0),
+		tail(0),
+		headCache(0),
+		slots(capacity),
+		mask(capacity - 1)
+	{}
+
+	bool tryPush(const T &t)
+	{
+		size_t tl = tail.load(std::memory_order_relaxed);
+		if(tl - headCache == slots.size()) {
+			headCache = head.load(std::memory_order_acquire);
+			if(tl - headCache == slots.size()) return false;
+		}
+		slots[tl & mask] = t;
+		tail.store(tl + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool tryPop(T &t)
+	{
+		size_t hd = head.load(std::memory_order_relaxed);
+		if(hd == tailCache) {
+			tailCache = tail.load(std::memory_order_acquire);
+			if(hd == tailCache) return false;
+		}
+		t = slots[hd & mask];
+		head.store(hd + 1, std::memory_order_release);
+		return true;
+	}
+};
+
+
+/*
+	runs an IBTLLexer on a second thread and hands its tokens to the
+	parser through an SpscRing, so that lexing and parsing overlap. At
+	most RING_SIZE tokens are buffered at any time.
+
+	a LexException thrown on the lexer thread is rethrown by getToken()
+	in place of the token the lexer failed to produce. Once TK_EOF is
+	reached it is returned indefinitely, like IBTLLexer.
+
+	the lexer must not be used by anyone else until the PipeLexer is
+	destroyed. Lexemes stay valid after that, as with IBTLLexer.
+*/
+class PipeLexer final : public Lexer
+{
+	static constexpr size_t RING_SIZE = 4096;
+
+	struct Slot
+	{
+		Token tok;
+		int line;
+	};
+
+	IBTLLexer &lexer;
+	SpscRing<Slot> ring;
+
+	// written by the lexer thread before it publishes its final TK_EOF
+	std::exception_ptr error;
+
+	// set when the consumer goes away before the end of the input
+	std::atomic<bool> cancelled;
+
+	Token last;
+	int curLine;
+	bool done;
+
+	std::thread producer;
+
+	void produce();
+
+	static inline void wait(int &spins)
+	{
+		if(++spins > 64) std::this_thread::yield();
+	}
+
+public:
+	PipeLexer(IBTLLexer &lexer);
+	~PipeLexer();
+
+	Token getToken()
+	{
+		if(done) return last;
+
+		Slot s;
+		int spins = 0;
+		while(!ring.tryPop(s)) wait(spins);
+
+		curLine = s.line;
+		if(s.tok.name == TK_EOF) {
+			done = true;
+			last = s.tok;
+			if(error) std::rethrow_exception(error);
+		}
+		return s.tok;
+	}
+
+	int line() {return curLine; }
+};
+
+#endif
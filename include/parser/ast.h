@@ -0,0 +1,161 @@
+
+#ifndef AST_H
+#define AST_H
+
+#include <vector>
+#include <initializer_list>
+#include <cstdint>
+#include <algorithm>
+#include <assert.h>
+#include <arena.h>
+#include <symtable.h>
+
+class Node;
+
+typedef uint32_t NodeId;
+
+// an index into Ast::symbols
+typedef uint32_t SymbolSlot;
+static constexpr SymbolSlot NO_SYMBOL = UINT32_MAX;
+
+enum NodeKind : uint8_t {
+	NK_PROGRAM,
+	NK_SCOPE,		// ContainerScopeNode
+	NK_TOKEN,
+	NK_EXPRLIST,
+	NK_VARLIST,
+	NK_IDLIST,
+	NK_TYPELIST,
+	NK_BINOP,
+	NK_UNOP,
+	NK_ASSIGN,
+	NK_CALL,
+	NK_IF,
+	NK_WHILE,
+	NK_LET,
+	NK_FUNCTION,
+	NK_PRINT
+};
+
+/*
+	a contiguous run of child nodes handed to a node constructor. A run
+	given as a braced list, as fixed-arity nodes do, is copied into the
+	NodeList itself, since the list's array is gone once the constructor
+	call's full-expression ends. Any other run is only pointed to.
+*/
+struct NodeList
+{
+	static constexpr size_t MAX_LISTED = 3;
+
+	Node *const *items;	// NULL if the children are in 'listed'
+	size_t count;
+	Node *listed[MAX_LISTED];
+
+	NodeList() :
+		items(NULL),
+		count(0)
+	{}
+
+	NodeList(std::initializer_list<Node *> list) :
+		items(NULL),
+		count(list.size())
+	{
+		assert(count <= MAX_LISTED);
+		std::copy(list.begin(), list.end(), listed);
+	}
+
+	NodeList(Node *const *items, size_t count) :
+		items(items),
+		count(count)
+	{}
+
+	inline Node *operator [](size_t i) const
+	{
+		return items ? items[i] : listed[i];
+	}
+};
+
+/*
+	flat storage for a parse tree. Per-node data lives in parallel arrays
+	indexed by NodeId, and the children of a node are a contiguous range
+	of 'childIds'. Node objects only carry their vtable and id; they are
+	allocated from 'arena' and released together with everything else by
+	reset().
+
+	nodes are added once all of their children exist, so a child's id is
+	always smaller than its parent's and the root is the last node. Only
+	Node::foldConstants() breaks this, by adding the literals it puts in
+	place of folded subtrees once the tree is complete.
+*/
+class Ast
+{
+public:
+	Arena arena;
+
+	std::vector<NodeKind> kind;
+	std::vector<Type> type;			// result type, set by Node::check()
+	std::vector<SymbolSlot> binding;	// for identifiers, set by resolveNames()
+	std::vector<int> line;
+	std::vector<uint32_t> firstChild;
+	std::vector<uint32_t> childCount;
+	std::vector<Node *> node;
+
+	std::vector<NodeId> childIds;
+
+	// every declaration in the tree, in the order resolveNames() met them
+	std::vector<SymbolData> symbols;
+	// the node that made each one: a FunctionNode, or a variable's id
+	std::vector<NodeId> declaredBy;
+
+	Ast() {}
+
+	Ast(const Ast &) = delete;
+	Ast &operator =(const Ast &) = delete;
+
+	NodeId add(Node *n, NodeKind k, int ln, NodeList children);
+
+	/*
+		appends the nodes of several trees built separately, in order.
+		reserve() makes room for all of them, and each part is then
+		moved into its slots by splice(), which may run concurrently for
+		different parts. A part's node ids are shifted by 'base' and its
+		child ids by 'childBase', and the part is left with no nodes.
+		Its nodes still live in its arena, which the caller must hand
+		over with Arena::adopt().
+	*/
+	void reserve(size_t nodes, size_t children);
+	void splice(Ast &part, NodeId base, size_t childBase);
+
+	inline size_t size() {return kind.size(); }
+
+	inline Node *child(NodeId parent, uint32_t i)
+	{
+		return node[childIds[firstChild[parent] + i]];
+	}
+
+	inline void setChild(NodeId parent, uint32_t i, NodeId c)
+	{
+		childIds[firstChild[parent] + i] = c;
+	}
+
+	/*
+		drops every node. Array capacity and the arena's largest block
+		are kept for the next tree.
+	*/
+	void reset()
+	{
+		kind.clear();
+		type.clear();
+		binding.clear();
+		line.clear();
+		firstChild.clear();
+		childCount.clear();
+		node.clear();
+		childIds.clear();
+		symbols.clear();
+		declaredBy.clear();
+		arena.reset();
+	}
+};
+
+#endif
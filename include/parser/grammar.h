@@ -0,0 +1,353 @@
+#ifndef GRAMMAR_H
+#define GRAMMAR_H
+
+#include <lexer/token.h>
+#include <cstdint>
+
+/*
+	the IBTL grammar as an LL(1) predict table, built at compile time from
+	the productions in makeGrammar(). IBTLParser::parse() runs it with an
+	explicit stack, so nesting depth is limited only by memory.
+
+	a production is a sequence of symbols:
+
+	  SY_DISCARD	matches a token and drops it
+	  SY_TAKE		matches a token and pushes a TokNode onto the value stack
+	  SY_RULE		expands a nonterminal through the predict table
+	  SY_ACTION		builds a node from the values on top of the value stack,
+	  				or records a line number or list start for a later action
+
+	rules follow the old recursive descent functions, with the
+	single-use helpers folded into their callers. Each rule has the same
+	error message its function used to report.
+*/
+
+constexpr int TK_COUNT = TK_PRINT + 1;
+
+enum SymKind : uint8_t {
+	SY_DISCARD,
+	SY_TAKE,
+	SY_RULE,
+	SY_ACTION
+};
+
+enum Rule : uint8_t {
+	R_PROGRAM,
+	R_SCOPELIST,
+	R_SCOPELIST_P,
+	R_SCOPE,
+	R_SCOPE_P,
+	R_EXPR,
+	R_EXPRSUFFIX,
+	R_OPER,
+	R_OPERSUFFIX,
+	R_MINUS_P,
+	R_CALLARGS,
+	R_IF_P,
+	R_LET_P,
+	R_VARLIST,
+	R_IDLIST,
+	R_TYPELIST,
+	R_TYPELIST_P,
+	R_EXPRLIST,
+	R_EXPRLIST_P,
+	R_COUNT
+};
+
+enum Action : uint8_t {
+	A_LINE,			// push the current line onto the line stack
+	A_MARK,			// start a list at the top of the value stack
+	A_MARK_TOP,		// start a list that includes the value on top
+	A_NULL,			// push a missing optional child
+
+	// node builders. Those that take a line from the line stack pop it;
+	// the others use the line at the time they run
+	A_PROGRAM,
+	A_CONTAINER,	// mark, line
+	A_EXPRLIST,		// mark, line
+	A_VARLIST,		// mark, line
+	A_IDLIST,		// mark, line (left on the stack for A_FUNCTION)
+	A_TYPELIST,		// mark, line
+	A_BINOP,
+	A_UNOP,
+	A_ASSIGN,
+	A_CALL,			// mark, line
+	A_IF,			// line
+	A_WHILE,
+	A_LET,
+	A_BODY,			// a function body: a scope list, or skipped if lazy
+	A_FUNCTION,		// line
+	A_PRINT
+};
+
+struct Sym
+{
+	uint8_t kind;
+	uint8_t arg;
+
+	static constexpr Sym discard(TokenName t) {return Sym{SY_DISCARD, (uint8_t)t}; }
+	static constexpr Sym take(TokenName t) {return Sym{SY_TAKE, (uint8_t)t}; }
+	static constexpr Sym rule(Rule r) {return Sym{SY_RULE, r}; }
+	static constexpr Sym action(Action a) {return Sym{SY_ACTION, a}; }
+};
+
+constexpr int MAX_PRODUCTION = 12;
+
+struct Production
+{
+	uint8_t len;
+	Sym syms[MAX_PRODUCTION];
+};
+
+enum Prod : uint8_t {
+	P_ERROR,		// no production predicted: report the rule's error
+	P_EMPTY,
+	P_PROGRAM,
+	P_SCOPELIST,
+	P_SCOPELIST_P,
+	P_SCOPE_EXPR,
+	P_SCOPE_BRAK,
+	P_SCOPE_LIST,
+	P_SCOPE_EMPTY,
+	P_SCOPE_SUFFIX,
+	P_EXPR_BRAK,
+	P_CONSTANT,
+	P_ID,
+	P_EXPR_OPER,
+	P_IF,
+	P_WHILE,
+	P_LET,
+	P_PRINT,
+	P_OPER_BRAK,
+	P_BINOP,
+	P_UNOP,
+	P_MINUS,
+	P_ASSIGN,
+	P_CALL,
+	P_MINUS_UNARY,
+	P_MINUS_BINARY,
+	P_CALLARGS,
+	P_IF_ELSE,
+	P_IF_NOELSE,
+	P_LET_VARS,
+	P_LET_FUNCTION,
+	P_VARLIST,
+	P_IDLIST,
+	P_TYPELIST,
+	P_TYPELIST_P,
+	P_EXPRLIST,
+	P_EXPRLIST_P,
+	P_COUNT
+};
+
+struct Grammar
+{
+	Production prods[P_COUNT];
+	uint8_t predict[R_COUNT][TK_COUNT];
+	const char *error[R_COUNT];
+};
+
+constexpr Grammar makeGrammar()
+{
+	Grammar g = {};
+
+	struct Def
+	{
+		Prod prod;
+		int len;
+		Sym syms[MAX_PRODUCTION];
+	};
+
+	constexpr auto discard = Sym::discard;
+	constexpr auto take = Sym::take;
+	constexpr auto rule = Sym::rule;
+	constexpr auto action = Sym::action;
+
+	const Def defs[] = {
+		{P_EMPTY,			0, {}},
+		{P_PROGRAM,			5, {discard(TK_OBRAK), rule(R_SCOPELIST),
+		                		action(A_PROGRAM), discard(TK_CBRAK),
+		                		discard(TK_EOF)}},
+		{P_SCOPELIST,		5, {action(A_LINE), action(A_MARK), rule(R_SCOPE),
+		                		rule(R_SCOPELIST_P), action(A_CONTAINER)}},
+		{P_SCOPELIST_P,		2, {rule(R_SCOPE), rule(R_SCOPELIST_P)}},
+		{P_SCOPE_EXPR,		1, {rule(R_EXPR)}},
+		{P_SCOPE_BRAK,		2, {discard(TK_OBRAK), rule(R_SCOPE_P)}},
+		{P_SCOPE_LIST,		2, {rule(R_SCOPELIST), discard(TK_CBRAK)}},
+		{P_SCOPE_EMPTY,		4, {action(A_LINE), action(A_MARK),
+		                		discard(TK_CBRAK), action(A_CONTAINER)}},
+		{P_SCOPE_SUFFIX,	1, {rule(R_EXPRSUFFIX)}},
+		{P_EXPR_BRAK,		2, {discard(TK_OBRAK), rule(R_EXPRSUFFIX)}},
+		{P_CONSTANT,		1, {take(TK_CONSTANT)}},
+		{P_ID,				1, {take(TK_ID)}},
+		{P_EXPR_OPER,		1, {rule(R_OPERSUFFIX)}},
+		{P_IF,				7, {discard(TK_IF), action(A_LINE), rule(R_EXPR),
+		                		rule(R_EXPR), rule(R_IF_P), action(A_IF),
+		                		discard(TK_CBRAK)}},
+		{P_WHILE,			5, {discard(TK_WHILE), rule(R_EXPR),
+		                		rule(R_EXPRLIST), action(A_WHILE),
+		                		discard(TK_CBRAK)}},
+		{P_LET,				5, {discard(TK_LET), discard(TK_OBRAK),
+		                		discard(TK_OBRAK), take(TK_ID), rule(R_LET_P)}},
+		{P_PRINT,			4, {discard(TK_PRINT), rule(R_OPER),
+		                		action(A_PRINT), discard(TK_CBRAK)}},
+		{P_OPER_BRAK,		2, {discard(TK_OBRAK), rule(R_OPERSUFFIX)}},
+		{P_BINOP,			5, {take(TK_BINOP), rule(R_OPER), rule(R_OPER),
+		                		action(A_BINOP), discard(TK_CBRAK)}},
+		{P_UNOP,			4, {take(TK_UNOP), rule(R_OPER), action(A_UNOP),
+		                		discard(TK_CBRAK)}},
+		{P_MINUS,			3, {take(TK_MINUS), rule(R_OPER), rule(R_MINUS_P)}},
+		{P_ASSIGN,			5, {discard(TK_ASSIGN), take(TK_ID), rule(R_OPER),
+		                		action(A_ASSIGN), discard(TK_CBRAK)}},
+		{P_CALL,			6, {action(A_LINE), action(A_MARK), take(TK_ID),
+		                		rule(R_CALLARGS), action(A_CALL),
+		                		discard(TK_CBRAK)}},
+		{P_MINUS_UNARY,		2, {discard(TK_CBRAK), action(A_UNOP)}},
+		{P_MINUS_BINARY,	3, {rule(R_OPER), discard(TK_CBRAK),
+		                		action(A_BINOP)}},
+		{P_CALLARGS,		2, {rule(R_OPER), rule(R_CALLARGS)}},
+		{P_IF_ELSE,			1, {rule(R_EXPR)}},
+		{P_IF_NOELSE,		1, {action(A_NULL)}},
+		{P_LET_VARS,		9, {action(A_LINE), action(A_MARK_TOP),
+		                		take(TK_TYPE), discard(TK_CBRAK),
+		                		rule(R_VARLIST), action(A_VARLIST),
+		                		action(A_LET), discard(TK_CBRAK),
+		                		discard(TK_CBRAK)}},
+		{P_LET_FUNCTION,	12, {action(A_LINE), action(A_MARK_TOP),
+		                		rule(R_IDLIST), action(A_IDLIST),
+		                		discard(TK_CBRAK), discard(TK_OBRAK),
+		                		rule(R_TYPELIST), discard(TK_CBRAK),
+		                		discard(TK_CBRAK), action(A_BODY),
+		                		discard(TK_CBRAK), action(A_FUNCTION)}},
+		{P_VARLIST,			5, {discard(TK_OBRAK), take(TK_ID), take(TK_TYPE),
+		                		discard(TK_CBRAK), rule(R_VARLIST)}},
+		{P_IDLIST,			2, {take(TK_ID), rule(R_IDLIST)}},
+		{P_TYPELIST,		5, {action(A_LINE), action(A_MARK), take(TK_TYPE),
+		                		rule(R_TYPELIST_P), action(A_TYPELIST)}},
+		{P_TYPELIST_P,		2, {take(TK_TYPE), rule(R_TYPELIST_P)}},
+		{P_EXPRLIST,		5, {action(A_LINE), action(A_MARK), rule(R_EXPR),
+		                		rule(R_EXPRLIST_P), action(A_EXPRLIST)}},
+		{P_EXPRLIST_P,		2, {rule(R_EXPR), rule(R_EXPRLIST_P)}}
+	};
+	for(const Def &d : defs) {
+		g.prods[d.prod].len = d.len;
+		for(int i = 0; i < d.len; i++)
+			g.prods[d.prod].syms[i] = d.syms[i];
+	}
+
+	struct Entry
+	{
+		Rule rule;
+		int tok;		// -1 for every token without an entry of its own
+		Prod prod;
+	};
+
+	const Entry entries[] = {
+		{R_PROGRAM,		-1,				P_PROGRAM},
+
+		{R_SCOPELIST,	-1,				P_SCOPELIST},
+
+		{R_SCOPELIST_P,	TK_CBRAK,		P_EMPTY},
+		{R_SCOPELIST_P,	TK_OBRAK,		P_SCOPELIST_P},
+		{R_SCOPELIST_P,	TK_ID,			P_SCOPELIST_P},
+		{R_SCOPELIST_P,	TK_CONSTANT,	P_SCOPELIST_P},
+
+		{R_SCOPE,		TK_CONSTANT,	P_SCOPE_EXPR},
+		{R_SCOPE,		TK_ID,			P_SCOPE_EXPR},
+		{R_SCOPE,		TK_OBRAK,		P_SCOPE_BRAK},
+
+		{R_SCOPE_P,		-1,				P_SCOPE_SUFFIX},
+		{R_SCOPE_P,		TK_OBRAK,		P_SCOPE_LIST},
+		{R_SCOPE_P,		TK_CONSTANT,	P_SCOPE_LIST},
+		{R_SCOPE_P,		TK_CBRAK,		P_SCOPE_EMPTY},
+
+		{R_EXPR,		TK_OBRAK,		P_EXPR_BRAK},
+		{R_EXPR,		TK_CONSTANT,	P_CONSTANT},
+		{R_EXPR,		TK_ID,			P_ID},
+
+		{R_EXPRSUFFIX,	TK_BINOP,		P_EXPR_OPER},
+		{R_EXPRSUFFIX,	TK_UNOP,		P_EXPR_OPER},
+		{R_EXPRSUFFIX,	TK_MINUS,		P_EXPR_OPER},
+		{R_EXPRSUFFIX,	TK_ASSIGN,		P_EXPR_OPER},
+		{R_EXPRSUFFIX,	TK_ID,			P_EXPR_OPER},
+		{R_EXPRSUFFIX,	TK_IF,			P_IF},
+		{R_EXPRSUFFIX,	TK_WHILE,		P_WHILE},
+		{R_EXPRSUFFIX,	TK_LET,			P_LET},
+		{R_EXPRSUFFIX,	TK_PRINT,		P_PRINT},
+
+		{R_OPER,		TK_OBRAK,		P_OPER_BRAK},
+		{R_OPER,		TK_CONSTANT,	P_CONSTANT},
+		{R_OPER,		TK_ID,			P_ID},
+
+		{R_OPERSUFFIX,	TK_BINOP,		P_BINOP},
+		{R_OPERSUFFIX,	TK_UNOP,		P_UNOP},
+		{R_OPERSUFFIX,	TK_MINUS,		P_MINUS},
+		{R_OPERSUFFIX,	TK_ASSIGN,		P_ASSIGN},
+		{R_OPERSUFFIX,	TK_ID,			P_CALL},
+
+		{R_MINUS_P,		-1,				P_MINUS_BINARY},
+		{R_MINUS_P,		TK_CBRAK,		P_MINUS_UNARY},
+
+		{R_CALLARGS,	-1,				P_CALLARGS},
+		{R_CALLARGS,	TK_CBRAK,		P_EMPTY},
+
+		{R_IF_P,		TK_OBRAK,		P_IF_ELSE},
+		{R_IF_P,		TK_ID,			P_IF_ELSE},
+		{R_IF_P,		TK_CONSTANT,	P_IF_ELSE},
+		{R_IF_P,		TK_CBRAK,		P_IF_NOELSE},
+
+		{R_LET_P,		TK_TYPE,		P_LET_VARS},
+		{R_LET_P,		TK_ID,			P_LET_FUNCTION},
+
+		{R_VARLIST,		TK_OBRAK,		P_VARLIST},
+		{R_VARLIST,		TK_CBRAK,		P_EMPTY},
+
+		{R_IDLIST,		TK_ID,			P_IDLIST},
+		{R_IDLIST,		TK_CBRAK,		P_EMPTY},
+
+		{R_TYPELIST,	-1,				P_TYPELIST},
+
+		{R_TYPELIST_P,	TK_TYPE,		P_TYPELIST_P},
+		{R_TYPELIST_P,	TK_CBRAK,		P_EMPTY},
+
+		{R_EXPRLIST,	-1,				P_EXPRLIST},
+
+		{R_EXPRLIST_P,	TK_OBRAK,		P_EXPRLIST_P},
+		{R_EXPRLIST_P,	TK_CONSTANT,	P_EXPRLIST_P},
+		{R_EXPRLIST_P,	TK_ID,			P_EXPRLIST_P},
+		{R_EXPRLIST_P,	TK_CBRAK,		P_EMPTY}
+	};
+	// defaults first, so that specific entries override them
+	for(const Entry &e : entries)
+		if(e.tok < 0)
+			for(int t = 0; t < TK_COUNT; t++)
+				g.predict[e.rule][t] = e.prod;
+	for(const Entry &e : entries)
+		if(e.tok >= 0)
+			g.predict[e.rule][e.tok] = e.prod;
+
+	g.error[R_PROGRAM] = "invalid program";
+	g.error[R_SCOPELIST] = "invalid scope";
+	g.error[R_SCOPELIST_P] = "unterminated list of scopes";
+	g.error[R_SCOPE] = "invalid scope";
+	g.error[R_SCOPE_P] = "invalid expr";
+	g.error[R_EXPR] = "invalid expr";
+	g.error[R_EXPRSUFFIX] = "invalid expr";
+	g.error[R_OPER] = "invalid oper";
+	g.error[R_OPERSUFFIX] = "invalid oper";
+	g.error[R_MINUS_P] = "invalid oper";
+	g.error[R_CALLARGS] = "invalid oper";
+	g.error[R_IF_P] = "invalid if statement";
+	g.error[R_LET_P] = "expected id or type in let statement";
+	g.error[R_VARLIST] = "invalid varlist";
+	g.error[R_IDLIST] = "invalid idlist";
+	g.error[R_TYPELIST] = "invalid typelist";
+	g.error[R_TYPELIST_P] = "invalid typelist";
+	g.error[R_EXPRLIST] = "invalid expr";
+	g.error[R_EXPRLIST_P] = "invalid exprlist";
+	return g;
+}
+
+constexpr Grammar grammar = makeGrammar();
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef LAZYBODY_H
+#define LAZYBODY_H
+
+#include <lexer/tokenbuffer.h>
+#include <vector>
+#include <cstdint>
+
+class Ast;
+class ContainerScopeNode;
+
+/*
+	function bodies that a lazy parse skipped (see IBTLParser::setLazy()).
+	The tokens stay in their TokenBuffer, and a FunctionNode parses its
+	body from there the first time the generator asks for it.
+
+	the parse also counts how often each identifier follows a '[', which
+	is where every call is, both in the code it parsed and in the bodies
+	it skipped. A function that never appears there is never called and
+	its body is never needed. Unless every body is to be checked, it is
+	then not parsed, resolved or type checked either, so errors in it go
+	unreported.
+*/
+class LazyBodies
+{
+	TokenBuffer &tokens;
+
+	// indexed by SymbolId
+	std::vector<uint32_t> calls;
+
+	bool checkAll;
+
+public:
+	LazyBodies(TokenBuffer &tokens) :
+		tokens(tokens),
+		calls(),
+		checkAll(false)
+	{}
+
+	// parse and check the bodies nothing calls too, only not generate them
+	inline void setCheckAll(bool all) {checkAll = all; }
+	inline bool checkingAll() {return checkAll; }
+
+	inline void countCall(SymbolId id)
+	{
+		if(id >= calls.size()) calls.resize(id + 1);
+		calls[id]++;
+	}
+
+	inline bool called(SymbolId id)
+	{
+		return id < calls.size() && calls[id] > 0;
+	}
+
+	/*
+		parses the body that starts at token 'pos', whose first lexeme
+		is lexemes['lex'], into 'ast'. Throws ParseException.
+	*/
+	ContainerScopeNode *parse(Ast &ast, uint32_t pos, uint32_t lex);
+};
+
+#endif
@@ -7,9 +7,13 @@
 #include <iostream>
 #include <sstream>
 #include <initializer_list>
+#include <assert.h>
 #include <lexer/token.h>
 #include <generator/generator.h>
+#include <generator/ir.h>
 #include <symtable.h>
+#include <parser/ast.h>
+#include <parser/lazybody.h>
 
 typedef Token tok;
 class Node;
@@ -28,6 +32,7 @@ class IfNode;
 class WhileNode;
 class LetNode;
 class PrintNode;
+class FunctionNode;
 class ExprListNode;
 class VarListNode;
 
@@ -37,73 +42,175 @@ std::string typeString(Type tp);
 
 Type tokenToType(TokenName name, TokenAttr attr);
 
-typedef std::ostream    Stream;
-
 class Node
 {
 	friend std::ostream &operator<<(std::ostream &, const Node &);
 
-public:
-	typedef std::vector<Node *> NodeArray;
-	NodeArray children;
-	bool isToken;
-    int mline;
+	// moves nodes between trees; see Ast::splice()
+	friend class Ast;
 
 protected:
-	
-	Node(NodeArray children) :
-		children(children),
-		isToken(false)
+    // everything but the node's behaviour lives in the tree's flat 
+    // storage; see Ast. That includes the children: accessors read them
+    // from the Ast and nodes keep no copies, so a pass that rewrites the
+    // tree only has to update it there
+    Ast *ast;
+    NodeId id;
+
+	Node(Ast &ast, NodeKind kind, int line, NodeList children = NodeList()) :
+		ast(&ast),
+        id(ast.add(this, kind, line, children))
 	{}
 
-	Node(int line, bool isToken = false) :
-		children(),
-		isToken(isToken),
-        mline(line)
-	{}
+    /*
+        nodes live in the Ast's arena and are never destroyed one at a 
+        time: the whole tree is released with Ast::reset(). Nothing a 
+        node owns may need its destructor to run.
+    */
+	~Node() {}
+
+    // records the result type of this node in the tree and returns it
+    inline Type setType(Type t) {return ast->type[id] = t; }
 
-    
 public:
-	virtual ~Node()
-	{
-		for(auto iter = children.cbegin(); iter != children.cend(); 
-		    iter++)
-			delete *iter;
-			
-	}
+    static void *operator new(size_t size, Arena &arena)
+    {
+        return arena.allocate(size);
+    }
+
+    static void operator delete(void *, Arena &) {}
 
 	virtual std::string name()
 	{
 		return std::string();
 	}
 
-    void error(const std::string &msg)
+    [[noreturn]] void error(const std::string &msg)
     {
         std::ostringstream str;
         str << "line " << line() << ": " << msg;
         throw GenException(str.str());
     }
 
-    void typeError(const std::string &msg) {error(msg); }
+    [[noreturn]] void typeError(const std::string &msg) {error(msg); }
     
 
-    int line() {return mline; }
+    inline Ast &tree() {return *ast; }
+    inline NodeId nodeId() {return id; }
+    inline NodeKind kind() {return ast->kind[id]; }
+    inline bool isToken() {return kind() == NK_TOKEN; }
+    inline int line() {return ast->line[id]; }
+
+    // the result type check() recorded
+    inline Type resultType() {return ast->type[id]; }
+
+    inline int childCount() {return ast->childCount[id]; }
+    inline Node *child(int i) {return ast->child(id, i); }
     
     /*
-        generates gforth code for this node. The code is written to
-        the output stream 'str' and indented by 'indent' tabs. The
-        default implementation simply calls generate() on all child
-        nodes and returns TP_NONE.
+        generates stack machine code for this node and everything below
+        it. The code is appended to 'ir' and indented by 'indent' tabs.
+        The tree is walked without recursion by calling genStep() on each
+        node; see walkTree(). emitGforth() then prints it.
+    */
+    void generate(IrCode &ir, SymbolTable &sym, int indent);
+
+    /*
+        generates step 'step' of this node's code and returns the child
+        to generate next, with its indent in 'childIndent', or NULL when
+        the node is done. The default implementation generates all
+        child nodes in order.
     */
-    virtual Type generate(Stream &str, SymbolTable &sym, int indent);
+    virtual Node *genStep(IrCode &ir, SymbolTable &sym, int step, 
+                          int indent, int &childIndent);
+
+    /*
+        generates this node as the condition of an if or a while, which
+        only tests it for zero. Only the code that decides the outcome 
+        runs: and and or skip their right operand once the left one
+        decides. See branch.cpp
+    */
+    void generateTest(IrCode &ir, SymbolTable &sym);
+
+    /*
+        like genStep(), for a node whose value is only tested by a
+        branch, so that any nonzero cell will do for true. 'childTest' 
+        starts out true and tells whether the child returned is also
+        only tested. The default implementation generates the value
+        with genStep().
+    */
+    virtual Node *testStep(IrCode &ir, SymbolTable &sym, int step,
+                           bool &childTest);
+
+    /*
+        type checks this node and everything below it and records each
+        node's result type for the generator. 'ctx' tells whether the
+        node is inside a function. Throws GenException.
+    */
+    void check(Context ctx);
+
+    /*
+        checks step 'step' of this node and returns the child to check
+        next, with its context in 'childCtx', or NULL when the node is
+        done. The default implementation checks all child nodes and 
+        leaves the type TP_NONE.
+    */
+    virtual Node *checkStep(int step, Context ctx, Context &childCtx);
+
+    /*
+        folds the constant subexpressions below this node into literals
+        and drops operations that cannot change their operand, such as
+        x*1 or not not b. Runs after check(), whose types it keeps, so 
+        the generator sees the same types it would have without 
+        folding. See fold.cpp.
+    */
+    void foldConstants();
+
+    /*
+        folds step 'step' of this node and returns the child to fold
+        next, or NULL when the node is done. On entry 'last' is the node
+        that replaces the child returned by the previous step; when the
+        node is done it is set to the node that replaces this one. The
+        default implementation folds all child nodes in order and then
+        calls simplify().
+    */
+    virtual Node *foldStep(int step, Node *&last);
+
+    // the node to use in place of this one, once its children are folded
+    virtual Node *simplify() {return this; }
+
+    // puts 'n' in place of child 'i'
+    inline void replaceChild(int i, Node *n)
+    {
+        ast->setChild(id, i, n->nodeId());
+    }
 	
 };
 
+/*
+    a checked downcast. Each node class has a static is(NodeKind) that
+    says which kinds it covers; the kind is asserted and the cast is
+    then a plain static_cast, with no RTTI. NULL is passed through.
+*/
+template<class T>
+inline T *nodeCast(Node *n)
+{
+    assert(!n || T::is(n->kind()));
+    return static_cast<T *>(n);
+}
+
 class ScopeNode : public Node
 {
 public:
-	ScopeNode(int line) :
-		Node(line)
+    static bool is(NodeKind k)
+    {
+        return k != NK_PROGRAM && k != NK_EXPRLIST && k != NK_VARLIST &&
+               k != NK_IDLIST && k != NK_TYPELIST;
+    }
+
+	ScopeNode(Ast &ast, NodeKind kind, int line,
+	          NodeList children = NodeList()) :
+		Node(ast, kind, line, children)
 	{}
 
 	virtual std::string name() {return std::string("scope"); }
@@ -112,83 +219,112 @@ public:
 class ContainerScopeNode : public ScopeNode
 {
 public:
-	ContainerScopeNode(int line) :
-		ScopeNode(line)
+    static bool is(NodeKind k) {return k == NK_SCOPE; }
+
+	ContainerScopeNode(Ast &ast, int line, NodeList scopes = NodeList()) :
+		ScopeNode(ast, NK_SCOPE, line, scopes)
 	{}
 
-    Type generate(Stream &str, SymbolTable &sym, int indent);
+    Node *genStep(IrCode &ir, SymbolTable &sym, int step, int indent,
+                  int &childIndent);
 
 };
 
 
 class ProgramNode : public Node
 {
+    // the helper words the code calls, set by reduceStrength()
+    unsigned helpers;
+
+    void genHelpers(IrCode &ir);
+
 public:
-	ProgramNode(ContainerScopeNode *sc, int line) :
-		Node(line)
-	{
-		children.push_back(sc);
-	}
+    static bool is(NodeKind k) {return k == NK_PROGRAM; }
+
+	ProgramNode(Ast &ast, ContainerScopeNode *sc, int line) :
+		Node(ast, NK_PROGRAM, line, {sc}),
+		helpers(0)
+	{}
+
+    /*
+        the strength reduction stage, run after foldConstants(). Works
+        out which helper words the generated code calls, so that they
+        are defined before the program. The operators themselves are
+        reduced as they are generated; see strength.cpp
+    */
+    void reduceStrength();
 
     inline ContainerScopeNode *scope()
     {
-        return dynamic_cast<ContainerScopeNode *>(children[0]);
+        return nodeCast<ContainerScopeNode>(child(0));
     }
 
 	std::string name() {return std::string("program"); }
 
-    Type generate(Stream &str, SymbolTable &sym, int indent);
+    Node *genStep(IrCode &ir, SymbolTable &sym, int step, int indent,
+                  int &childIndent);
 };
 
 
 class ExprNode : public ScopeNode
 {
-protected:
-	ExprNode(int line) :
-		ScopeNode(line)
-	{}
 public:
+    static bool is(NodeKind k) {return k != NK_SCOPE && ScopeNode::is(k); }
 
-	virtual ~ExprNode() {}
+protected:
+	ExprNode(Ast &ast, NodeKind kind, int line,
+	         NodeList children = NodeList()) :
+		ScopeNode(ast, kind, line, children)
+	{}
 };
 
 class StmtNode : public ExprNode
 {
+public:
+    static bool is(NodeKind k)
+    {
+        return k == NK_IF || k == NK_WHILE || k == NK_LET || 
+               k == NK_FUNCTION || k == NK_PRINT;
+    }
+
 protected:
-	StmtNode(int line) :
-		ExprNode(line)
+	StmtNode(Ast &ast, NodeKind kind, int line,
+	         NodeList children = NodeList()) :
+		ExprNode(ast, kind, line, children)
 	{}
-public:
-	virtual ~StmtNode() {}
 };
 
 class OperNode : public ExprNode
 {
-protected:
-	OperNode(int line) :
-		ExprNode(line)
-	{}
 public:
-	virtual ~OperNode() {}
+    static bool is(NodeKind k)
+    {
+        return k == NK_TOKEN || k == NK_BINOP || k == NK_UNOP || 
+               k == NK_ASSIGN || k == NK_CALL;
+    }
 
+protected:
+	OperNode(Ast &ast, NodeKind kind, int line,
+	         NodeList children = NodeList()) :
+		ExprNode(ast, kind, line, children)
+	{}
 };
 
 class TokNode : public OperNode
 {
 	friend std::ostream &operator <<(std::ostream &str, TokNode &tok);
+	friend class TreeDumper;
 	tok token;
 
-    void genBool(Stream &str);
-    void genReal(Stream &str);
-    Type genVariable(Stream &str, SymbolTable &sym);
+    void genBool(IrCode &ir);
 
 public:
-	TokNode(tok token, int line) :
-		OperNode(line),
+    static bool is(NodeKind k) {return k == NK_TOKEN; }
+
+	TokNode(Ast &ast, tok token, int line) :
+		OperNode(ast, NK_TOKEN, line),
 		token(token)
-	{
-		isToken = true;
-	}
+	{}
 
     inline TokenAttr attr() 
     {
@@ -199,7 +335,22 @@ public:
 
     inline TokenName type() {return token.name; }
 
-    inline std::string &val() {return token.val; }
+    inline std::string_view val() {return token.val; }
+
+    // for int and real constants
+    inline NumValue num() {return token.num; }
+
+    inline bool isLiteral() {return token.name == TK_CONSTANT; }
+
+    // for identifiers
+    inline SymbolId symbol() {return token.sym; }
+
+    // the declaration an identifier refers to, once resolveNames() has
+    // run. Declaring identifiers are bound to their own declaration
+    inline void bind(SymbolSlot slot) {ast->binding[id] = slot; }
+    inline bool isBound() {return ast->binding[id] != NO_SYMBOL; }
+    inline SymbolSlot slot() {return ast->binding[id]; }
+    inline SymbolData &binding() {return ast->symbols[ast->binding[id]]; }
 
 	std::string name() {
 		std::ostringstream str;
@@ -207,15 +358,27 @@ public:
 		return str.str();
 	}
 
-    Type generate(Stream &str, SymbolTable &sym, int indent);
+    Node *genStep(IrCode &ir, SymbolTable &sym, int step, int indent,
+                  int &childIndent);
+    Node *checkStep(int step, Context ctx, Context &childCtx);
 
 };
 
+// 'n' if it is a literal, or NULL
+inline TokNode *literalOf(Node *n)
+{
+    if(!n->isToken()) return NULL;
+    TokNode *t = nodeCast<TokNode>(n);
+    return t->isLiteral() ? t : NULL;
+}
+
 class ExprListNode : public Node
 {
 public:
-	ExprListNode(int line) :
-		Node(line)
+    static bool is(NodeKind k) {return k == NK_EXPRLIST; }
+
+	ExprListNode(Ast &ast, int line, NodeList items) :
+		Node(ast, NK_EXPRLIST, line, items)
 	{}
 
 	std::string name() {return std::string("exprlist"); }
@@ -224,19 +387,21 @@ public:
 class VarListNode : public Node
 {
 public:
-	VarListNode(int line) :
-		Node(line)
+    static bool is(NodeKind k) {return k == NK_VARLIST; }
+
+	VarListNode(Ast &ast, int line, NodeList items) :
+		Node(ast, NK_VARLIST, line, items)
 	{}
 
-    int varCount() {return children.size() / 2; }
+    int varCount() {return childCount() / 2; }
     
-    std::pair<std::string, Type> item(int i)
+    std::pair<TokNode *, Type> item(int i)
     {
         i = i * 2;
-        TokNode *id = dynamic_cast<TokNode *>(children[i]);
-        TokNode *type = dynamic_cast<TokNode *>(children[i+1]);
-        return std::pair<std::string, Type>(
-            id->val(),
+        TokNode *id = nodeCast<TokNode>(child(i));
+        TokNode *type = nodeCast<TokNode>(child(i+1));
+        return std::pair<TokNode *, Type>(
+            id,
             tokenToType(type->type(), type->attr())
             );
     }
@@ -247,13 +412,15 @@ public:
 class IdListNode : public Node
 {
 public:
-	IdListNode(int line) :
-		Node(line)
+    static bool is(NodeKind k) {return k == NK_IDLIST; }
+
+	IdListNode(Ast &ast, int line, NodeList items) :
+		Node(ast, NK_IDLIST, line, items)
 	{}
 
-    int count() {return children.size(); }
-    std::string item(int i) {
-        return (dynamic_cast<TokNode *>(children[i]))->val();
+    int count() {return childCount(); }
+    TokNode *item(int i) {
+        return nodeCast<TokNode>(child(i));
     }
 
 	std::string name() {return std::string("idlist"); }
@@ -262,13 +429,15 @@ public:
 class TypeListNode : public Node
 {
 public:
-	TypeListNode(int line) :
-		Node(line)
+    static bool is(NodeKind k) {return k == NK_TYPELIST; }
+
+	TypeListNode(Ast &ast, int line, NodeList items) :
+		Node(ast, NK_TYPELIST, line, items)
 	{}
 
-    int count() {return children.size(); }
+    int count() {return childCount(); }
     Type item(int i) {
-        TokNode *t = dynamic_cast<TokNode *>(children[i]);
+        TokNode *t = nodeCast<TokNode>(child(i));
         return tokenToType(t->type(), t->attr());
     }
 
@@ -281,30 +450,43 @@ public:
 
 class BinopNode : public OperNode
 {
-    void genReal(Type l, Type r, Stream &str);
-    void genInt(Stream &str);
-    void genBool(Type l, Type r, Stream &str);
-    void genStr(Stream &str);
+    void genReal(Type l, Type r, IrCode &ir);
+    void genInt(IrCode &ir);
+    void genBool(Type l, Type r, IrCode &ir);
+    void genStr(IrCode &ir);
     Type typeCheckBoolOp(Type l, Type r);
     Type typeCheckCompareOp(Type l, Type r);
     Type typeCheckNumOp(Type l, Type r);
     Type typeCheckExpOp(Type l, Type r);
     Type typeCheck(Type l, Type r);
+    Node *foldLiterals(TokNode *l, TokNode *r);
+    Node *foldIdentity(TokNode *l, TokNode *r);
+    void genReduced(TokNode *k, IrCode &ir);
 
 public:
-	BinopNode(TokNode *op, OperNode *l, OperNode *r, int line) :
-		OperNode(line)
-	{
-		children.push_back(op);
-		children.push_back(l);
-		children.push_back(r);
-	}
+    // the largest literal exponent of a real ^ that is generated as a
+    // chain of multiplies rather than a call to real-pow. The two round
+    // differently, and folding has to follow whichever is generated
+    static constexpr int64_t MAX_REAL_CHAIN = 16;
+
+    // the helper words strength reduction calls
+    enum Helper {
+        HELPER_NONE = 0,
+        HELPER_INT_POW = 1,
+        HELPER_REAL_POW = 2
+    };
+
+    static bool is(NodeKind k) {return k == NK_BINOP; }
+
+	BinopNode(Ast &ast, TokNode *op, OperNode *l, OperNode *r, int line) :
+		OperNode(ast, NK_BINOP, line, {op, l, r})
+	{}
 
-    inline TokNode *op()        {return dynamic_cast<TokNode *>(children[0]); }
-    inline OperNode *left()     {return dynamic_cast<OperNode *>(children[1]); }
-    inline OperNode *right()    {return dynamic_cast<OperNode *>(children[2]); }
+    inline TokNode *op()        {return nodeCast<TokNode>(child(0)); }
+    inline OperNode *left()     {return nodeCast<OperNode>(child(1)); }
+    inline OperNode *right()    {return nodeCast<OperNode>(child(2)); }
 
-    inline void binopError(const std::string &msg, Type l, Type r)
+    [[noreturn]] inline void binopError(const std::string &msg, Type l, Type r)
     {
         std::ostringstream str;
         str << "line " << line() << ": " << msg << " (have " <<
@@ -314,7 +496,18 @@ public:
 
     std::string opString() {return Token::attrToString(op()->attr()); }
 
-    Type generate(Stream &str, SymbolTable &sym, int indent);
+    Node *genStep(IrCode &ir, SymbolTable &sym, int step, int indent,
+                  int &childIndent);
+    Node *checkStep(int step, Context ctx, Context &childCtx);
+    Node *simplify();
+    Node *testStep(IrCode &ir, SymbolTable &sym, int step, bool &childTest);
+
+    // the literal operand that strength reduction builds into the code
+    // for the operator, or NULL
+    TokNode *constOperand();
+
+    // the helper word the code for the operator calls
+    Helper helper();
 
 	std::string name() {return std::string("binop"); }
 };
@@ -322,23 +515,22 @@ public:
 
 class UnopNode : public OperNode
 {
-    void genReal(Type l, Stream &str);
-    void genInt(Stream &str);
-    void genBool(Stream &str);
+    void genReal(Type l, IrCode &ir);
+    void genInt(IrCode &ir);
+    void genBool(IrCode &ir);
     Type typeCheck(Type l);
 
 public:
-	UnopNode(TokNode *op, OperNode *l, int line) :
-		OperNode(line)
-	{
-		children.push_back(op);
-		children.push_back(l);
-	}
+    static bool is(NodeKind k) {return k == NK_UNOP; }
+
+	UnopNode(Ast &ast, TokNode *op, OperNode *l, int line) :
+		OperNode(ast, NK_UNOP, line, {op, l})
+	{}
     
-    inline TokNode *op()        {return dynamic_cast<TokNode *>(children[0]); }
-    inline OperNode *left()     {return dynamic_cast<OperNode *>(children[1]); }
+    inline TokNode *op()        {return nodeCast<TokNode>(child(0)); }
+    inline OperNode *left()     {return nodeCast<OperNode>(child(1)); }
 
-    inline void unopError(const std::string &msg, Type l)
+    [[noreturn]] inline void unopError(const std::string &msg, Type l)
     {
         std::ostringstream str;
         str << "line " << line() << ": " << msg << " (have " <<
@@ -348,28 +540,32 @@ public:
 
     std::string opString() {return Token::attrToString(op()->attr()); }
 
-    Type generate(Stream &str, SymbolTable &sym, int indent);
+    Node *genStep(IrCode &ir, SymbolTable &sym, int step, int indent,
+                  int &childIndent);
+    Node *checkStep(int step, Context ctx, Context &childCtx);
+    Node *simplify();
+    Node *testStep(IrCode &ir, SymbolTable &sym, int step, bool &childTest);
 
 	std::string name() {return std::string("unop"); }
 };
 
 class AssignNode : public OperNode
 {
-
     Type typeCheck(Type ltype, Type rtype);
 
 public:
-	AssignNode(TokNode *id, OperNode *oper, int line) :
-		OperNode(line)
-	{
-		children.push_back(id);
-		children.push_back(oper);
-	}
+    static bool is(NodeKind k) {return k == NK_ASSIGN; }
+
+	AssignNode(Ast &ast, TokNode *id, OperNode *oper, int line) :
+		OperNode(ast, NK_ASSIGN, line, {id, oper})
+	{}
 	
-    inline TokNode *id() {return dynamic_cast<TokNode *>(children[0]); }
-    inline OperNode *oper() {return dynamic_cast<OperNode *>(children[1]); }
+    inline TokNode *id() {return nodeCast<TokNode>(child(0)); }
+    inline OperNode *oper() {return nodeCast<OperNode>(child(1)); }
 
-    Type generate(Stream &str, SymbolTable &sym, int indent);
+    Node *genStep(IrCode &ir, SymbolTable &sym, int step, int indent,
+                  int &childIndent);
+    Node *checkStep(int step, Context ctx, Context &childCtx);
 
 	std::string name() {return std::string("assign"); }
 };
@@ -380,15 +576,23 @@ class CallNode : public OperNode
     void typeCheck(SymbolData &dat, int paramIndex, Type paramType);
 
 public:
-	CallNode(int line) :
-		OperNode(line)
+    static bool is(NodeKind k) {return k == NK_CALL; }
+
+    // 'args' holds the function id followed by the parameters
+	CallNode(Ast &ast, int line, NodeList args) :
+		OperNode(ast, NK_CALL, line, args)
 	{}
 	
-    inline TokNode *funcId() {return dynamic_cast<TokNode *>(children[0]); }
-    int paramCount() {return children.size()-1; }
-    inline OperNode *param(int i) {return dynamic_cast<OperNode *>(children[i+1]); }
+    inline TokNode *funcId() {return nodeCast<TokNode>(child(0)); }
+    int paramCount() {return childCount()-1; }
+    inline OperNode *param(int i) {return nodeCast<OperNode>(child(i+1)); }
+
+    // the function called, once resolveNames() has bound the call
+    FunctionNode *function();
 
-    Type generate(Stream &str, SymbolTable &sym, int indent);
+    Node *genStep(IrCode &ir, SymbolTable &sym, int step, int indent,
+                  int &childIndent);
+    Node *checkStep(int step, Context ctx, Context &childCtx);
 
 	std::string name() {return std::string("call"); }
 };
@@ -401,24 +605,25 @@ public:
 class IfNode : public StmtNode
 {
 public:
-	IfNode(int line, ExprNode *condExpr, ExprNode *thenStmt, ExprNode *elseStmt = NULL) :
-		StmtNode(line)
-	{
-		children.push_back(condExpr);
-		children.push_back(thenStmt);
-		if(elseStmt) children.push_back(elseStmt);
-	}
+    static bool is(NodeKind k) {return k == NK_IF; }
 
-    inline ExprNode *condExpr() {return dynamic_cast<ExprNode *>(children[0]); }
-    inline ExprNode *thenExpr() {return dynamic_cast<ExprNode *>(children[1]); }
-    inline ExprNode *elseExpr() {
-        if(children.size() == 3)
-            return dynamic_cast<ExprNode *>(children[2]);
-        else
-            return NULL;
-     }
+	IfNode(Ast &ast, int line, ExprNode *condExpr, ExprNode *thenStmt, ExprNode *elseStmt = NULL) :
+		StmtNode(ast, NK_IF, line, 
+		         elseStmt ? NodeList({condExpr, thenStmt, elseStmt}) : 
+		                    NodeList({condExpr, thenStmt}))
+	{}
 
-    Type generate(Stream &str, SymbolTable &sym, int indent);
+    inline ExprNode *condExpr() {return nodeCast<ExprNode>(child(0)); }
+    inline ExprNode *thenExpr() {return nodeCast<ExprNode>(child(1)); }
+
+    inline ExprNode *elseExpr()
+    {
+        return childCount() > 2 ? nodeCast<ExprNode>(child(2)) : NULL;
+    }
+
+    Node *genStep(IrCode &ir, SymbolTable &sym, int step, int indent,
+                  int &childIndent);
+    Node *checkStep(int step, Context ctx, Context &childCtx);
 
 	std::string name() {return std::string("if"); }	
 };
@@ -426,52 +631,120 @@ public:
 class WhileNode : public StmtNode
 {
 public:
-	WhileNode(ExprNode *condExpr, ExprListNode *bodyList, int line) :
-		StmtNode(line)
-	{
-		children.push_back(condExpr);
-		children.push_back(bodyList);
-	}
+    static bool is(NodeKind k) {return k == NK_WHILE; }
 
-    inline ExprNode *condExpr() {return dynamic_cast<ExprNode *>(children[0]); }
-    inline ExprListNode *bodyList() {return dynamic_cast<ExprListNode *>(children[1]); }
+	WhileNode(Ast &ast, ExprNode *condExpr, ExprListNode *bodyList, int line) :
+		StmtNode(ast, NK_WHILE, line, {condExpr, bodyList})
+	{}
+
+    inline ExprNode *condExpr() {return nodeCast<ExprNode>(child(0)); }
+    inline ExprListNode *bodyList() {return nodeCast<ExprListNode>(child(1)); }
 
-    Type generate(Stream &str, SymbolTable &sym, int indent);
+    Node *genStep(IrCode &ir, SymbolTable &sym, int step, int indent,
+                  int &childIndent);
+    Node *checkStep(int step, Context ctx, Context &childCtx);
 
 	std::string name() {return std::string("while"); }
 };
 
 class LetNode : public StmtNode
 {
-    void genVar(Stream &str, const std::string &varname, Type type);
+    void genVar(IrCode &ir, const std::string &varname, Type type);
 
 public:
-	LetNode(VarListNode *varlist, int line) :
-		StmtNode(line)
-	{
-		children.push_back(varlist);
-	}
+    static bool is(NodeKind k) {return k == NK_LET; }
 
-    inline VarListNode *varlist() {return dynamic_cast<VarListNode *>(children[0]); }
+	LetNode(Ast &ast, VarListNode *varlist, int line) :
+		StmtNode(ast, NK_LET, line, {varlist})
+	{}
+
+    inline VarListNode *varlist() {return nodeCast<VarListNode>(child(0)); }
 
-    Type generate(Stream &str, SymbolTable &sym, int indent);
+    Node *genStep(IrCode &ir, SymbolTable &sym, int step, int indent,
+                  int &childIndent);
+    Node *checkStep(int step, Context ctx, Context &childCtx);
 
 	std::string name() {return std::string("let"); }
 };
 
 class FunctionNode : public StmtNode
 {
+    // for a body skipped by a lazy parse: where its tokens are, and the
+    // body once it has been parsed
+    LazyBodies *lazy;
+    uint32_t bodyPos;
+    uint32_t bodyLex;
+    ContainerScopeNode *lazyBody;
+
+    // what isPure() found, once it has looked
+    enum Purity : uint8_t {
+        PURITY_UNKNOWN,
+        PURITY_OPEN,        // being looked at, further up the call chain
+        PURITY_PURE,
+        PURITY_IMPURE
+    };
+    Purity purity;
 
 public:
-    FunctionNode(int line) :
-        StmtNode(line)
+    static bool is(NodeKind k) {return k == NK_FUNCTION; }
+
+    FunctionNode(Ast &ast, int line, IdListNode *ids, TypeListNode *types,
+                 ContainerScopeNode *body) :
+        StmtNode(ast, NK_FUNCTION, line, {ids, types, body}),
+        lazy(NULL),
+        bodyPos(0),
+        bodyLex(0),
+        lazyBody(NULL),
+        purity(PURITY_UNKNOWN)
+    {}
+
+    // a function whose body starts at token 'bodyPos' and has not been
+    // parsed yet. The body is not a child of the node
+    FunctionNode(Ast &ast, int line, IdListNode *ids, TypeListNode *types,
+                 LazyBodies *lazy, uint32_t bodyPos, uint32_t bodyLex) :
+        StmtNode(ast, NK_FUNCTION, line, {ids, types}),
+        lazy(lazy),
+        bodyPos(bodyPos),
+        bodyLex(bodyLex),
+        lazyBody(NULL),
+        purity(PURITY_UNKNOWN)
     {}
 
-    inline IdListNode *idlist() {return dynamic_cast<IdListNode *>(children[0]); }
-    inline TypeListNode *typelist() {return dynamic_cast<TypeListNode *>(children[1]); }
-    inline ContainerScopeNode *body() {return dynamic_cast<ContainerScopeNode *>(children[2]); }
+    inline IdListNode *idlist() {return nodeCast<IdListNode>(child(0)); }
+    inline TypeListNode *typelist() {return nodeCast<TypeListNode>(child(1)); }
+
+    // parses a lazy body on first use. Throws ParseException
+    inline ContainerScopeNode *body()
+    {
+        if(!lazy) return nodeCast<ContainerScopeNode>(child(2));
+        if(!lazyBody) lazyBody = lazy->parse(*ast, bodyPos, bodyLex);
+        return lazyBody;
+    }
+
+    // false only for a lazy function that is never called
+    inline bool bodyNeeded()
+    {
+        return !lazy || lazy->called(idlist()->item(0)->symbol());
+    }
+
+    // whether resolveNames() and check() go through the body
+    inline bool bodyChecked()
+    {
+        return !lazy || lazy->checkingAll() || bodyNeeded();
+    }
     
-    Type generate(Stream &str, SymbolTable &sym, int indent);
+    Node *genStep(IrCode &ir, SymbolTable &sym, int step, int indent,
+                  int &childIndent);
+    Node *checkStep(int step, Context ctx, Context &childCtx);
+    Node *foldStep(int step, Node *&last);
+
+    /*
+        whether a call can be left out without changing what the program
+        does: the body prints nothing, assigns only to its own variables
+        and calls only pure functions. A recursive function is taken to
+        be impure. See branch.cpp
+    */
+    bool isPure();
 
     std::string name() {return std::string("function"); }
 };
@@ -479,15 +752,17 @@ public:
 class PrintNode : public StmtNode
 {
 public:
-	PrintNode(OperNode *oper, int line) :
-		StmtNode(line)
-	{
-		children.push_back(oper);
-	}
+    static bool is(NodeKind k) {return k == NK_PRINT; }
+
+	PrintNode(Ast &ast, OperNode *oper, int line) :
+		StmtNode(ast, NK_PRINT, line, {oper})
+	{}
 
-    inline OperNode *oper() {return dynamic_cast<OperNode *>(children[0]); }
+    inline OperNode *oper() {return nodeCast<OperNode>(child(0)); }
 
-    Type generate(Stream &str, SymbolTable &sym, int indent);
+    Node *genStep(IrCode &ir, SymbolTable &sym, int step, int indent,
+                  int &childIndent);
+    Node *checkStep(int step, Context ctx, Context &childCtx);
 
 	std::string name() {return std::string("print"); }
 };
@@ -3,83 +3,90 @@
 #define NEWPARSER_H
 
 #include <lexer/lexer.h>
+#include <lexer/tokenbuffer.h>
+#include <lexer/tokenring.h>
 #include <parser/newnodes.h> //TODO: change name of file
+#include <parser/grammar.h>
 #include <exception>
 #include <string>
+#include <vector>
 
 
 class ParseException : public std::exception
 {
 	std::string msg;
-	int line;
 public:
 	
 	ParseException(const std::string &msg, int line) :
-		msg(msg),
-		line(line)
-	{}
+		msg()
+	{
+		std::ostringstream str;
+		str << "line " << line << ": " << msg;
+		this->msg = str.str();
+	}
 
 	~ParseException() throw() {}
 	
 	const char *what() const throw()
 	{
-		std::ostringstream str;
-		str << "line " << line << ": " << msg;
-		return str.str().c_str();
+		return msg.c_str();
 	}
 };
 
 
+/*
+	the parser is a template over its token source so that getToken()
+	and line() are direct calls that the compiler can inline, instead of
+	virtual calls through Lexer. It is instantiated in newparser.cpp for
+	the streaming IBTLLexer, for TokenCursor, which replays tokens cached
+	in a TokenBuffer, and for PipeLexer, which runs the lexer on a
+	second thread.
+*/
+template<class Source>
 class IBTLParser
 {
-	IBTLLexer &lexer;
+	Source &lexer;
+	Ast &ast;
 	tok cur;
 
-	// forward declarations
-	ProgramNode *T();
-	ContainerScopeNode *scopelist();
-	ContainerScopeNode *scopelist(ContainerScopeNode *sc);
-	ContainerScopeNode *scopelist_p(ContainerScopeNode *sc);
-	ScopeNode *scope();
-	ScopeNode *scope1();
-	ScopeNode *scope_p();
-	ScopeNode *scope_p1();
-	ScopeNode *scope_p2();
-	ContainerScopeNode *scope_p3();
-	ExprNode *expr();
-	ExprNode *exprsuffix();
-	OperNode *oper();
-	OperNode *oper1();
-	OperNode *opersuffix();
-	BinopNode *binop();
-	UnopNode *unop();
-	OperNode *minus();
-	OperNode *minus_p();
-	OperNode *minus_p1();
-	OperNode *minus_p2();
-    CallNode *call();
-	TokNode *constant();
-	TokNode *id();
-	AssignNode *assign();
-	StmtNode *stmtsuffix();
-	IfNode *ifstmts();
-	ExprNode *ifstmts_p();
-	WhileNode *whilestmts();
-	StmtNode *letstmts();
-    StmtNode *letstmts_p(TokNode *firstId);
-    FunctionNode *funcstmts(TokNode *firstId);
-	PrintNode *printstmts();
-	ExprListNode *exprlist();
-	ExprListNode *exprlist(ExprListNode *list);
-	ExprListNode *exprlist_p(ExprListNode *list);
-	VarListNode *varlist();
-	VarListNode *varlist(VarListNode *list);
-	VarListNode *varlist_p(VarListNode *list);
-	IdListNode *idlist(IdListNode *list);
-    IdListNode *idlist_p(IdListNode *list);
-    TypeListNode *typelist();
-    TypeListNode *typelist(TypeListNode *list);
-    TypeListNode *typelist_p(TypeListNode *list);
+	// the value stack: nodes that are still waiting for their parent.
+	// The items of a list are pushed here and copied into the tree as
+	// one contiguous range when the list is complete
+	std::vector<Node *> pending;
+
+	// the parse stack of grammar symbols still to be matched, and the
+	// line numbers and list starts recorded for actions that have not
+	// run yet
+	std::vector<Sym> stack;
+	std::vector<int> lines;
+	std::vector<size_t> marks;
+
+	// set for a lazy parse
+	LazyBodies *lazy;
+
+	void run(Rule start);
+	void expand(Rule r);
+	void reduce(Action a);
+	bool skipBody();
+
+	/*
+		removes the node on top of the value stack
+	*/
+	template<class T>
+	inline T *pop()
+	{
+		T *t = nodeCast<T>(pending.back());
+		pending.pop_back();
+		return t;
+	}
+
+	template<class T>
+	inline T popBack(std::vector<T> &v)
+	{
+		T t = v.back();
+		v.pop_back();
+		return t;
+	}
 
 	void err(const char *msg)
 	{
@@ -93,6 +100,28 @@ class IBTLParser
 			(std::string("expected ") + std::string(Token::nameToString(expect))).c_str());
 	}
 
+	/*
+		allocates a node in the tree
+	*/
+	template<class T, class... Args>
+	inline T *make(Args... args)
+	{
+		return new (ast.arena) T(ast, args...);
+	}
+
+	/*
+		allocates a list node whose items are everything pushed onto
+		'pending' since 'mark'
+	*/
+	template<class T, class... Args>
+	inline T *makeList(size_t mark, Args... args)
+	{
+		T *t = make<T>(args..., 
+		               NodeList(pending.data() + mark, pending.size() - mark));
+		pending.resize(mark);
+		return t;
+	}
+
 	/*
 		take current token and advance to next.
 		throw exception if token does not match 'expect'.
@@ -100,7 +129,7 @@ class IBTLParser
 	TokNode *take(TokenName expect)
 	{
 		require(expect);
-		TokNode *t = new TokNode(cur, line());
+		TokNode *t = make<TokNode>(cur, line());
 		cur = lexer.getToken();
 		return t;
 	}
@@ -127,16 +156,47 @@ class IBTLParser
 	
 	
 public:
-	IBTLParser(IBTLLexer &lexer) :
+	/*
+		the tree returned by parse() is stored in 'ast' and stays valid 
+		until it is reset or destroyed
+	*/
+	IBTLParser(Source &lexer, Ast &ast) :
 		lexer(lexer),
-		cur()
+		ast(ast),
+		cur(),
+		pending(),
+		stack(),
+		lines(),
+		marks(),
+		lazy(NULL)
 	{}
 
-	ProgramNode *parse() {
-		cur = lexer.getToken();
-		return T();
-	}
+	/*
+		makes the parser skip function bodies instead of parsing them,
+		leaving them to 'bodies'. Only a parser over a TokenCursor can
+		skip; others ignore this.
+	*/
+	void setLazy(LazyBodies *bodies) {lazy = bodies; }
+
+	ProgramNode *parse();
+
+	/*
+		parses 'count' consecutive scopes, the items of a scope list,
+		and stores their nodes in 'out'. Used to parse the top level of
+		a program in pieces; see parseParallel()
+	*/
+	void parseScopes(size_t count, std::vector<Node *> &out);
+
+	/*
+		parses a scope list that is followed by ']', the body of a
+		function. See LazyBodies::parse()
+	*/
+	ContainerScopeNode *parseBody();
 };
 
+extern template class IBTLParser<IBTLLexer>;
+extern template class IBTLParser<TokenCursor>;
+extern template class IBTLParser<PipeLexer>;
+
 #endif
 
@@ -0,0 +1,20 @@
+#ifndef PARALLELPARSE_H
+#define PARALLELPARSE_H
+
+#include <lexer/tokenbuffer.h>
+#include <parser/newnodes.h>
+
+/*
+	parses the program in 'tokens' into 'ast', with the same result as
+	IBTLParser over a TokenCursor, including the ParseException reported
+	for a bad program.
+
+	when there are enough tokens, the bracket structure is indexed first
+	and the items of the top level scope list are parsed in groups on up
+	to 'threads' threads, each into a tree of its own. The trees are then
+	spliced into 'ast' in order and wrapped in the top level
+	ContainerScopeNode and the ProgramNode.
+*/
+ProgramNode *parseParallel(TokenBuffer &tokens, Ast &ast, unsigned threads);
+
+#endif
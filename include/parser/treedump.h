@@ -0,0 +1,87 @@
+#ifndef TREEDUMP_H
+#define TREEDUMP_H
+
+#include <parser/newnodes.h>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+enum DumpFormat {
+	DUMP_TEXT,		// the indented tree -p has always printed
+	DUMP_SEXPR,		// one line: (kind child ...), tokens as atoms
+	DUMP_BINARY		// see TreeDumper
+};
+
+/*
+	writes parse trees to a stream through a buffer that is kept from
+	one tree to the next. Nothing is allocated per node and the stream
+	only sees one write per BUFFER_SIZE bytes, plus one at the end of
+	each tree.
+
+	in an s-expression an identifier or constant is written as its text
+	from the source, and an operator or type as its attribute, so
+	[+ x 1] is (binop + x 1).
+
+	the binary format is, for every node in preorder:
+
+		u8	NodeKind
+		u32	line
+	then for a token:
+		u8	TokenName
+		u8	TokenAttr
+		u32	length of the text, followed by the text
+	or for any other node:
+		u32	number of children
+
+	each tree starts with the four bytes "IBT1". Numbers are little
+	endian.
+*/
+class TreeDumper
+{
+	static constexpr size_t BUFFER_SIZE = 1 << 16;
+
+	std::ostream &out;
+	DumpFormat format;
+	std::vector<char> buf;
+	size_t used;
+
+	// grows to the deepest indent seen so far
+	std::string tabs;
+
+	inline void put(char c)
+	{
+		if(used == buf.size()) flush();
+		buf[used++] = c;
+	}
+
+	void write(const char *s, size_t n);
+	void write(std::string_view s) {write(s.data(), s.size()); }
+	void indent(int depth);
+	void putU32(uint32_t v);
+
+	void token(TokNode *tok);
+
+public:
+	TreeDumper(std::ostream &out, DumpFormat format = DUMP_TEXT) :
+		out(out),
+		format(format),
+		buf(BUFFER_SIZE),
+		used(0),
+		tabs()
+	{}
+
+	~TreeDumper() {flush(); }
+
+	DumpFormat dumpFormat() {return format; }
+
+	// writes the tree below 'root' and flushes the buffer
+	void dump(Node *root);
+
+	void flush();
+
+	// one step of the walk; see walkTree()
+	Node *step(Node *node, int step, int depth, int &childDepth);
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef WALK_H
+#define WALK_H
+
+#include <vector>
+
+class Node;
+
+/*
+	walks the tree below 'root' with an explicit stack instead of
+	recursion, so that a deeply nested program costs heap rather than
+	call stack.
+
+	a visit is a sequence of steps. For step 0, 1, 2, ... of a node the
+	walker calls
+
+		Node *v.step(Node *n, int step, int arg, int &childArg)
+
+	which does that step's work and returns the child to walk next, or
+	NULL once the node is done. A returned child is walked completely,
+	with 'childArg' as its argument (childArg starts out as 'arg'),
+	before the node's next step. So a node can do work before, between
+	and after its children, visit them in any order and skip some.
+	'arg' carries whatever the visitor needs to pass down, such as an
+	indent or a context.
+*/
+template<class Visitor>
+void walkTree(Node *root, int arg, Visitor &v)
+{
+	struct Frame
+	{
+		Node *node;
+		int step;
+		int arg;
+	};
+
+	std::vector<Frame> stack;
+	stack.push_back(Frame{root, 0, arg});
+	while(!stack.empty()) {
+		Frame &f = stack.back();
+		int childArg = f.arg;
+		Node *next = v.step(f.node, f.step++, f.arg, childArg);
+		if(next)
+			stack.push_back(Frame{next, 0, childArg});
+		else
+			stack.pop_back();
+	}
+}
+
+#endif
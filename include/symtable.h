@@ -3,8 +3,9 @@
 #define SYMTABLE_H
 
 #include <lexer/token.h>
-#include <unordered_map>
+#include <deque>
 #include <vector>
+#include <cstdint>
 #include <iostream>
 #include <string>
 
@@ -41,6 +42,9 @@ struct SymbolData
     std::vector<Type> paramType;
     int paramCount;
 
+    // where a resolved tree keeps the declaration; see resolveNames()
+    uint32_t slot;
+
     SymbolData(TokenName name, TokenAttr attr, const std::string &outputName, 
                Type type) :
         name(name),
@@ -60,129 +64,164 @@ struct SymbolData
 	{}
 };
 
-typedef std::unordered_map<std::string, SymbolData> ScopeTable;
-
+/*
+	all the bindings in scope, in one open-addressing hash table keyed by
+	SymbolId. A slot holds the innermost binding of its identifier, and
+	each binding links to the one it shadows.
+
+	bindings live in a stack in the order they were declared, so the
+	bindings of the current scope are always on top and the stack is
+	also the undo log: leaving a scope pops them and puts back what they
+	shadowed, which costs O(declarations in the scope). Lookups cost the
+	same at any depth.
+*/
 class SymbolTable
 {
-	std::vector<ScopeTable> table;
+	static constexpr uint32_t NONE = UINT32_MAX;
+
+	struct Slot
+	{
+		SymbolId id;
+		// innermost binding, or NONE if it went out of scope
+		uint32_t binding;
+	};
+
+	struct Binding
+	{
+		SymbolData data;
+		uint32_t slot;
+		uint32_t shadowed;
+		int depth;
+	};
+
+	// the capacity is a power of two and at most half of it is used.
+	// Slots are never emptied; an identifier keeps its slot for the
+	// life of the table
+	std::vector<Slot> slots;
+	size_t used;
+
+	// a deque so that find() results stay put as bindings are added
+	std::deque<Binding> bindings;
+
+	// where each open scope starts in 'bindings'
+	std::vector<uint32_t> scopes;
+
     Context ctx;
 
-    // returns the global scope, which is always at the bottom of the 
-	// stack
-	inline ScopeTable &globals() {return table[0]; }
+	inline size_t hash(SymbolId id)
+	{
+		return (id * 0x9E3779B1u) & (slots.size() - 1);
+	}
+
+	// the slot of 'id', or the empty slot where it belongs
+	Slot &lookup(SymbolId id)
+	{
+		size_t i = hash(id);
+		while(slots[i].id != id && slots[i].id != NONE)
+			i = (i + 1) & (slots.size() - 1);
+		return slots[i];
+	}
+
+	void grow()
+	{
+		std::vector<Slot> old(slots.size() * 2, Slot{NONE, NONE});
+		old.swap(slots);
+		for(Slot &s : old) {
+			if(s.id == NONE) continue;
+			Slot &moved = lookup(s.id);
+			moved = s;
+			// keep the bindings' back links right
+			for(uint32_t b = s.binding; b != NONE; b = bindings[b].shadowed)
+				bindings[b].slot = &moved - slots.data();
+		}
+	}
+
+	// adds a binding for 'id' in the current scope, or returns NULL if
+	// there is one already
+	SymbolData *bind(SymbolId id)
+	{
+		if((used + 1) * 2 > slots.size()) grow();
+		Slot &s = lookup(id);
+		if(s.id == NONE) {
+			s.id = id;
+			used++;
+		}
+		else if(s.binding != NONE && 
+		        bindings[s.binding].depth == scopeDepth())
+			return NULL;
+
+		bindings.push_back(Binding{SymbolData(), 
+		                           uint32_t(&s - slots.data()), s.binding,
+		                           scopeDepth()});
+		s.binding = bindings.size() - 1;
+		return &bindings.back().data;
+	}
 
 public:
 	SymbolTable() :
-		table(),
+		slots(64, Slot{NONE, NONE}),
+		used(0),
+		bindings(),
+		scopes(),
         ctx(CTX_OUTSIDE_FUNC)
 	{
-		// add outermost (global) scope to table
-		table.push_back(ScopeTable());
-
-		// add keywords to global scope
-		ScopeTable &glob = table.front();
-
-		glob["if"] = SymbolData(TK_IF);
-		glob["while"] = SymbolData(TK_WHILE);
-		glob["let"] = SymbolData(TK_LET);
-		glob["stdout"] = SymbolData(TK_PRINT);
-
-		glob["bool"] = SymbolData(TK_TYPE, AT_KBOOL);
-		glob["int"] = SymbolData(TK_TYPE, AT_KINT);
-        // TODO: verify these are correct type names
-		glob["float"] = SymbolData(TK_TYPE, AT_KREAL);
-		glob["string"] = SymbolData(TK_TYPE, AT_KSTR);
-
-		glob["true"] = SymbolData(TK_CONSTANT, AT_T);
-		glob["false"] = SymbolData(TK_CONSTANT, AT_F);
-		
-		glob["and"] = SymbolData(TK_BINOP, AT_AND);
-		glob["or"] = SymbolData(TK_BINOP, AT_OR);
-		glob["not"] = SymbolData(TK_UNOP, AT_NOT);
-		glob["sin"] = SymbolData(TK_UNOP, AT_SIN);
-		glob["cos"] = SymbolData(TK_UNOP, AT_COS);
-		glob["tan"] = SymbolData(TK_UNOP, AT_TAN);
+		// open the outermost (global) scope. Keywords are not kept
+		// here; see lexer/keywords.h
+		enterScope();
 	}
 
-	inline void enterScope() {table.push_back(ScopeTable()); }
-	inline void exitScope() {table.pop_back(); }
-    inline int scopeDepth() {return table.size(); }
+	inline void enterScope() {scopes.push_back(bindings.size()); }
+
+	void exitScope()
+	{
+		while(bindings.size() > scopes.back()) {
+			Binding &b = bindings.back();
+			slots[b.slot].binding = b.shadowed;
+			bindings.pop_back();
+		}
+		scopes.pop_back();
+	}
+
+    inline int scopeDepth() {return scopes.size(); }
     
     inline Context context() {return ctx; }
     inline void setContext(Context c) {ctx = c; }
 
     /* 
        declares the identifier 'id' in the current scope with type 
-       'type'. returns true on success, false if the variable is already 
-       defined in current scope
+       'type'. returns its new SymbolData, or NULL if the variable is
+       already defined in current scope
     */
-    bool declare(const std::string &id, const std::string &outputName,
-                 Type type)
+    SymbolData *declare(SymbolId id, const std::string &outputName, 
+                        Type type)
     {
-        ScopeTable &local = table.back();
-        if(local.find(id) == local.end()) {
-            local[id] = SymbolData(TK_ID, AT_NONE, outputName, type); 
-            return true;
-        }
-        else
-            return false;
+        SymbolData *dat = bind(id);
+        if(!dat) return NULL;
+        *dat = SymbolData(TK_ID, AT_NONE, outputName, type);
+        return dat;
     }
 
-    bool declareFunction(const std::string &id, const std::string &outputName,
-                         Type returnType, std::vector<Type> &parms)
+    SymbolData *declareFunction(SymbolId id, const std::string &outputName,
+                                Type returnType, std::vector<Type> &parms)
     {
-        ScopeTable &local = table.back();
-        if(local.find(id) == local.end()) {
-            SymbolData dat = SymbolData(TK_ID, AT_NONE, outputName, 
-                                        returnType); 
-            dat.paramCount = parms.size();
-            dat.paramType = parms;
-            local[id] = dat;
-            return true;
-        }
-        else
-            return false; 
+        SymbolData *dat = bind(id);
+        if(!dat) return NULL;
+        *dat = SymbolData(TK_ID, AT_NONE, outputName, returnType);
+        dat->paramCount = parms.size();
+        dat->paramType = parms;
+        return dat;
     }
 
     /*
-        finds the declaration of 'id' by searching scopes inner to outer.
-        If id is declared, returns true and 'dat' contains the associated 
-        SymbolData. Otherwise returns false.
+        finds the innermost declaration of 'id'. Returns NULL if id is
+        not declared. The data stays valid until its scope is left.
     */
-    bool find(const std::string &id, SymbolData &dat)
+    SymbolData *find(SymbolId id)
     {
-        for(auto riter = table.rbegin(); riter != table.rend(); riter++) {
-            ScopeTable &cur = *riter;
-            auto entry = cur.find(id);
-            if(entry != cur.end()) {
-                dat = entry->second;
-                return true;
-            }
-        }
-
-        return false;
+        Slot &s = lookup(id);
+        return s.id == NONE || s.binding == NONE ? 
+               NULL : &bindings[s.binding].data;
     }
-	
-	
-
-	/*
-		helper function for lexer to determine whether a lexeme is
-		a keyword. If it is, 'name' and 'attr' describe the matching
-		keyword.
-	*/
-	bool isKeyword(const char *lexeme, TokenName &name, TokenAttr &attr)
-	{
-		ScopeTable &glob = globals();
-		auto iter = glob.find(lexeme);
-		if(iter != glob.end()) {
-			SymbolData &dat = iter->second;
-			name = dat.name;
-			attr = dat.attr;
-			return true;
-		}
-		else
-			return false;
-	}
 };
 
 #endif
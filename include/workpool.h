@@ -0,0 +1,93 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+/*
+	runs a fixed set of tasks, numbered 0 to count-1, on several threads
+	with work stealing. Each thread starts with a contiguous run of tasks
+	and takes them from the front of its own queue; a thread whose queue
+	is empty steals from the back of the others. Tasks of very different
+	sizes still keep every thread busy until the end.
+
+	no tasks are added while the pool runs, so a thread that finds every
+	queue empty is done.
+*/
+class WorkPool
+{
+	struct Queue
+	{
+		std::mutex lock;
+		std::deque<size_t> tasks;
+	};
+
+	unsigned threads;
+
+	static bool popFront(Queue &q, size_t &task)
+	{
+		std::lock_guard<std::mutex> guard(q.lock);
+		if(q.tasks.empty()) return false;
+		task = q.tasks.front();
+		q.tasks.pop_front();
+		return true;
+	}
+
+	static bool popBack(Queue &q, size_t &task)
+	{
+		std::lock_guard<std::mutex> guard(q.lock);
+		if(q.tasks.empty()) return false;
+		task = q.tasks.back();
+		q.tasks.pop_back();
+		return true;
+	}
+
+public:
+	WorkPool(unsigned threads) :
+		threads(threads ? threads : 1)
+	{}
+
+	/*
+		calls fn(task) for every task and returns when all are done.
+		The calling thread is one of the workers.
+	*/
+	template<class Fn>
+	void run(size_t count, Fn fn)
+	{
+		size_t n = threads < count ? threads : count;
+		if(n <= 1) {
+			for(size_t i = 0; i < count; i++) fn(i);
+			return;
+		}
+
+		std::deque<Queue> queues(n);
+		for(size_t i = 0; i < count; i++)
+			queues[i * n / count].tasks.push_back(i);
+
+		auto worker = [&](size_t self) {
+			size_t task;
+			while(true) {
+				if(popFront(queues[self], task)) {
+					fn(task);
+					continue;
+				}
+				bool stole = false;
+				for(size_t k = 1; k < n && !stole; k++)
+					stole = popBack(queues[(self + k) % n], task);
+				if(!stole) return;
+				fn(task);
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for(size_t i = 1; i < n; i++)
+			workers.emplace_back(worker, i);
+		worker(0);
+		for(std::thread &t : workers) t.join();
+	}
+};
+
+#endif
@@ -0,0 +1,31 @@
+
+#include <lexer/bracketindex.h>
+
+BracketIndex::BracketIndex(TokenBuffer &tokens) :
+	match(tokens.size(), NO_MATCH),
+	lexemeAt(tokens.size()),
+	balanced(true)
+{
+	std::vector<uint32_t> open;
+	uint32_t lexemes = 0;
+
+	for(uint32_t i = 0; i < tokens.size(); i++) {
+		TokenName name = (TokenName)tokens.names[i];
+		lexemeAt[i] = lexemes;
+		if(TokenBuffer::hasLexeme(name, (TokenAttr)tokens.attrs[i]))
+			lexemes++;
+
+		if(name == TK_OBRAK)
+			open.push_back(i);
+		else if(name == TK_CBRAK) {
+			if(open.empty()) {
+				balanced = false;
+				continue;
+			}
+			match[i] = open.back();
+			match[open.back()] = i;
+			open.pop_back();
+		}
+	}
+	if(!open.empty()) balanced = false;
+}
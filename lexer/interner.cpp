@@ -0,0 +1,59 @@
+
+#include <lexer/interner.h>
+#include <cstring>
+
+Interner::Interner() :
+	storage(),
+	names(),
+	hashes(),
+	slots(256, 0)
+{}
+
+// FNV-1a
+uint32_t Interner::hash(std::string_view s)
+{
+	uint32_t h = 2166136261u;
+	for(size_t i = 0; i < s.size(); i++) {
+		h ^= (unsigned char)s[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+void Interner::grow()
+{
+	std::vector<uint32_t> bigger(slots.size() * 2, 0);
+	size_t mask = bigger.size() - 1;
+	for(SymbolId id = 0; id < names.size(); id++) {
+		size_t i = hashes[id] & mask;
+		while(bigger[i]) i = (i + 1) & mask;
+		bigger[i] = id + 1;
+	}
+	slots.swap(bigger);
+}
+
+SymbolId Interner::intern(std::string_view s)
+{
+	uint32_t h = hash(s);
+	size_t mask = slots.size() - 1;
+	size_t i = h & mask;
+
+	while(slots[i]) {
+		SymbolId id = slots[i] - 1;
+		if(hashes[id] == h && names[id] == s) return id;
+		i = (i + 1) & mask;
+	}
+
+	// first occurrence: keep a copy of the name
+	char *copy = static_cast<char *>(storage.allocate(s.size(), 1));
+	std::memcpy(copy, s.data(), s.size());
+
+	SymbolId id = names.size();
+	names.push_back(std::string_view(copy, s.size()));
+	hashes.push_back(h);
+	slots[i] = id + 1;
+
+	// keep the load factor under 1/2
+	if(names.size() * 2 > slots.size()) grow();
+	return id;
+}
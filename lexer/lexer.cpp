@@ -3,30 +3,30 @@
 #include <lexer/lexer.h>
 #include <lexer/token.h>
 #include <lexer/reader.h>
-#include <symtable.h>
+#include <lexer/keywords.h>
+#include <lexer/scan.h>
+#include <lexer/numberdfa.h>
+#include <charconv>
+#include <cstdint>
 
 using namespace std;
 
-bool isoct(char c) {return '0' <= c && c <= '7'; }
-bool ishex(char c) {return std::isdigit(c) || 'a' <= c && c <= 'f' ||
-		    'A' <= c && c <= 'F'; }
-
 /*
 	reads the current lexeme from the input. If it is a keyword, a keyword
-	token is returned. Otherwise, an identifier token is 
-	returned.
+	token is returned. Otherwise, an identifier token carrying the
+	identifier's interned id is returned.
 */
 Token IBTLLexer::makeIdToken()
 {
-	const char *lexeme = input.getLexeme();
+	std::string_view lexeme = input.getLexeme();
 	Token tok;
 
-	// the token is only an identifier if the symbol table says its
-	// not a keyword
-	if(!symTable.isKeyword(lexeme, tok.name, tok.attr)) {
+	// the token is only an identifier if it is not a keyword
+	if(!lookupKeyword(lexeme, tok.name, tok.attr)) {
 		tok.name = TK_ID;
 		tok.attr = AT_NONE;
-		tok.val = std::string(lexeme);
+		tok.sym = names.intern(lexeme);
+		tok.val = names.name(tok.sym);
 	}
 	return tok;
 }
@@ -39,10 +39,8 @@ Token IBTLLexer::makeIdToken()
 */
 Token IBTLLexer::makeLiteralToken(TokenAttr attr)
 {
-	const char *lexeme = input.getLexeme();
-	// note: the Token is an rvalue, so its move ctor will be invoked and
-	// cause efficient copying of lexeme
-	return Token(lexeme, TK_CONSTANT, attr);
+	// note: with a mapped input this does not copy the lexeme
+	return Token(input.keepLexeme(), TK_CONSTANT, attr);
 }
 
 
@@ -57,9 +55,10 @@ Token IBTLLexer::readId()
 {
 	char c;
 
+	input.skipIdent();
 	while(true) {
 		c = input.getChar();
-		if(std::isalnum(c) || c == '_') continue;
+		if(isIdChar(c)) continue;
 		else break;
 	}
 
@@ -71,6 +70,7 @@ Token IBTLLexer::readId()
 Token IBTLLexer::readString()
 {
 	char c;
+	input.skipString();
 	while(true) {
 		c = input.getChar();
 		if(c == 0)
@@ -85,113 +85,67 @@ Token IBTLLexer::readString()
 
 Token IBTLLexer::readNumber(char c)
 {
-	enum {
-		q0, q1, q2, q3, q4, q5, q6, q7, q8, q9, q10, q11, q12,
-		q1_12, q1_8, q1_9, acceptDec, acceptOct, acceptHex,
-		acceptReal, reject
-	} state = q0;
-	
-	while(true) {
-		switch(state) {
-		case q0:
-			if(c == '0') state = q1_8;
-			else if(std::isdigit(c)) state = q1_12;
-			else if(c == '.') state = q3;
-			else state = reject;
-			break;
-		case q1:
-			c = input.getChar();
-			if(std::isdigit(c)) state = q1;
-			else if(c == '.') state = q2;
-			else state = reject;
-			break;
-		case q2:
-			c = input.getChar();
-			if(std::isdigit(c)) state = q2;
-			else if(c == 'e' || c == 'E') state = q5;
-			else state = acceptReal;
-			break;
-		case q3:
-			c = input.getChar();
-			if(std::isdigit(c)) state = q4;
-			else state = reject;
-			break;
-		case q4:
-			c = input.getChar();
-			if(std::isdigit(c)) state = q4;
-			else if(c == 'e' || c == 'E') state = q5;
-			else state = acceptReal;
-			break;
-		case q5:
-			c = input.getChar();
-			if(std::isdigit(c)) state = q6;
-			else if(c == '+' || c == '-') state = q7;
-			else state = reject;
-			break;
-		case q6:
-			c = input.getChar();
-			if(std::isdigit(c)) state = q6;
-			else state = acceptReal;
-			break;
-		case q7:
-			c = input.getChar();
-			if(std::isdigit(c)) state = q6;
-			else state = reject;
-			break;
-		case q1_8:
-			c = input.getChar();
-			if(c == 'x' || c == 'X') state = q10;
-			else if(isoct(c)) state = q1_9;
-			else if(std::isdigit(c)) state = q1;
-			else if(c == '.') state = q2;
-            else if(c == 'e' || c == 'E') state = q5;
-			else state = acceptDec;
-			break;
-		case q1_9:
-			c = input.getChar();
-			if(isoct(c)) state = q1_9;
-			else if(std::isdigit(c)) state = q1;
-			else if(c == '.') state = q2;
-            else if(c == 'e' || c == 'E') state = q5;
-			else state = acceptOct;
-			break;
-		case q1_12:
-			c = input.getChar();
-			if(std::isdigit(c)) state = q1_12;
-			else if(c == '.') state = q2;
-            else if(c == 'e' || c == 'E') state = q5;
-			else state = acceptDec;
-			break;
-		case q10:
-			c = input.getChar();
-			if(ishex(c)) state = q11;
-			else state = reject;
-			break;
-		case q11:
-			c = input.getChar();
-			if(ishex(c)) state = q11;
-			else state = acceptHex;
-			break;
-		case acceptDec:
-			input.putChar();
-			return makeLiteralToken(AT_INT_DEC);
-			break;
-		case acceptOct:
-			input.putChar();
-			return makeLiteralToken(AT_INT_OCT);
-			break;
-		case acceptHex:
-			input.putChar();
-			return makeLiteralToken(AT_INT_HEX);
-			break;
-		case acceptReal:
-			input.putChar();
-			return makeLiteralToken(AT_REAL);
-			break;
-		case reject:
-			throw LexException("invalid numeric constant", input);
-		}
+	const NumberDfa &dfa = numberDfa;
+	int state = dfa.next[NS_Q0][dfa.cls[(unsigned char)c]];
+
+	while(state < NS_FIRST_FINAL) {
+		if(dfa.digitLoop[state]) input.skipDigits();
+		c = input.getChar();
+		state = dfa.next[state][dfa.cls[(unsigned char)c]];
 	}
+
+	TokenAttr attr;
+	switch(state) {
+	case NS_ACCEPT_DEC:		attr = AT_INT_DEC; break;
+	case NS_ACCEPT_OCT:		attr = AT_INT_OCT; break;
+	case NS_ACCEPT_HEX:		attr = AT_INT_HEX; break;
+	case NS_ACCEPT_REAL:	attr = AT_REAL; break;
+	default:
+		throw LexException("invalid numeric constant", input);
+	}
+
+	// the last char read is not part of the constant
+	input.putChar();
+	Token tok = makeLiteralToken(attr);
+	numberValue(tok);
+	return tok;
+}
+
+/*
+	computes the binary value of a numeric constant accepted by
+	readNumber()
+*/
+void IBTLLexer::numberValue(Token &tok)
+{
+	std::string_view s = tok.val;
+
+	if(tok.attr == AT_REAL) {
+		auto res = std::from_chars(s.data(), s.data() + s.size(), tok.num.r);
+		if(res.ec != std::errc())
+			throw LexException("real constant out of range", input);
+		return;
+	}
+
+	unsigned base = 10;
+	size_t i = 0;
+	if(tok.attr == AT_INT_HEX) {
+		base = 16;
+		i = 2;
+	}
+	else if(tok.attr == AT_INT_OCT)
+		base = 8;
+
+	// ints are cells: anything that fits in 64 bits is accepted, and
+	// values above INT64_MAX wrap around
+	uint64_t val = 0;
+	for(; i < s.size(); i++) {
+		char c = s[i];
+		unsigned digit = isDigitChar(c) ? c - '0' : (c | 0x20) - 'a' + 10;
+		if(val > (UINT64_MAX - digit) / base)
+			throw LexException("integer constant out of range", input);
+		val = val * base + digit;
+	}
+	tok.num.i = (int64_t)val;
 }
 
 Token IBTLLexer::readRelop(char c)
@@ -211,9 +165,10 @@ Token IBTLLexer::readRelop(char c)
 		next = input.getChar();
 		if(next == '=')
 			return makeOpToken(TK_BINOP, AT_GE);
-		else
+		else {
 			input.putChar();
 			return makeOpToken(TK_BINOP, AT_GT);
+		}
 		break;
 	case '=':
 		return makeOpToken(TK_BINOP, AT_EQ);
@@ -222,9 +177,9 @@ Token IBTLLexer::readRelop(char c)
 		next = input.getChar();
 		if(next == '=')
 			return makeOpToken(TK_BINOP, AT_NE);
-		else
-			throw LexException("unrecognized operator", input);
+		break;
 	}
+	throw LexException("unrecognized operator", input);
 }
 
 
@@ -258,8 +213,9 @@ Token IBTLLexer::readOp(char c)
 
 void IBTLLexer::readWs()
 {
+	input.skipSpace();
 	char c = input.getChar();
-	while(std::isspace(c) && c != 0)
+	while(isSpaceChar(c))
 		c = input.getChar();
 	input.putChar();
 	input.clearLexeme();
@@ -272,15 +228,16 @@ Token IBTLLexer::getToken()
 
 	// first consume any leading ws
 	readWs();
+	tokOffset = input.getStartOffset();
 
 	c = input.getChar();
 	if(c == 0)
 		ret = Token(TK_EOF);
 	else if(c == '\"')
 		ret = readString();
-	else if(std::isalpha(c) || c == '_')
+	else if(isAlphaChar(c) || c == '_')
 		ret = readId();
-	else if(std::isdigit(c) || c == '.')
+	else if(isDigitChar(c) || c == '.')
 		ret = readNumber(c);
 	else
 		ret = readOp(c);
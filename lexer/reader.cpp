@@ -1,5 +1,45 @@
 
 #include <lexer/reader.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &filename) :
+	addr(NULL),
+	len(0),
+	mapped(false)
+{
+	int fd = open(filename.c_str(), O_RDONLY);
+	if(fd < 0) return;
+
+	struct stat st;
+	if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		len = st.st_size;
+		if(len == 0) {
+			// mmap rejects empty mappings
+			addr = "";
+			mapped = true;
+		}
+		else {
+			void *p = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(p != MAP_FAILED) {
+				madvise(p, len, MADV_SEQUENTIAL);
+				addr = static_cast<const char *>(p);
+				mapped = true;
+			}
+		}
+	}
+	close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if(mapped && len)
+		munmap(const_cast<char *>(addr), len);
+}
+
 
 Reader::Reader(std::istream *in) :
 	in(in),
@@ -8,11 +48,52 @@ Reader::Reader(std::istream *in) :
 	quotemode(false),
 	readbuf(),
 	pos(0),
+	mapped(false),
+	data(NULL),
+	size(0),
+	cur(0),
+	start(0),
+	saved(),
+	line(1),
+	startline(line),
+	scan(scanKernels())
+{}
+
+Reader::Reader(const char *data, size_t size) :
+	in(NULL),
+	charbuf(0),
+	charbuf_full(false),
+	quotemode(false),
+	pos(0),
+	mapped(true),
+	data(data),
+	size(size),
+	cur(0),
+	start(0),
+	saved(),
 	line(1),
-	startline(line)
+	startline(line),
+	scan(scanKernels())
 {}
 
-char Reader::getChar()
+Reader::Reader(const char *data, size_t begin, size_t end, int line) :
+	in(NULL),
+	charbuf(0),
+	charbuf_full(false),
+	quotemode(false),
+	pos(0),
+	mapped(true),
+	data(data),
+	size(end),
+	cur(begin),
+	start(begin),
+	saved(),
+	line(line),
+	startline(line),
+	scan(scanKernels())
+{}
+
+char Reader::streamGetChar()
 {
 	char c;
 	
@@ -26,13 +107,14 @@ char Reader::getChar()
 	}
 		
 	if(c == '\n') line++;
+	cur++;
 
     if(pos >= BUFSIZE) c = 0;
 	else readbuf[pos++] = c;
 	return c;
 }
 
-void Reader::putChar()
+void Reader::streamPutChar()
 {
 	if(charbuf_full)
 		throw std::exception();
@@ -40,17 +122,53 @@ void Reader::putChar()
 	charbuf_full = true;
 	if(charbuf == '\n') line--;
 	pos--;
+	cur--;
+}
+
+void Reader::skipSpace()
+{
+	if(!mapped || cur >= size) return;
+	cur = scan.skipSpace(data + cur, data + size, line) - data;
 }
 
-const char *Reader::getLexeme()
+void Reader::skipIdent()
 {
-	// null terminate the buffer
-	readbuf[pos] = 0;
-	return readbuf;
+	if(!mapped || cur >= size) return;
+	cur = scan.skipIdent(data + cur, data + size) - data;
+}
+
+void Reader::skipDigits()
+{
+	if(!mapped || cur >= size) return;
+	cur = scan.skipDigits(data + cur, data + size) - data;
+}
+
+void Reader::skipString()
+{
+	if(!mapped || cur >= size) return;
+	cur = scan.skipString(data + cur, data + size, line) - data;
+}
+
+std::string_view Reader::getLexeme()
+{
+	if(mapped) {
+		size_t end = cur < size ? cur : size;
+		return std::string_view(data + start, end - start);
+	}
+	return std::string_view(readbuf, pos);
+}
+
+std::string_view Reader::keepLexeme()
+{
+	if(mapped) return getLexeme();
+
+	saved.push_back(std::string(readbuf, pos));
+	return saved.back();
 }
 
 void Reader::clearLexeme()
 {
 	startline = line;
-	pos = 0;
+	start = cur;
+	if(!mapped) pos = 0;
 }
@@ -0,0 +1,337 @@
+
+#include <lexer/scan.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+/********************************************************
+ scalar kernels, also used for the tail of the input
+********************************************************/
+
+static const char *skipSpaceScalar(const char *p, const char *end, int &lines)
+{
+	while(p < end && isSpaceChar(*p)) {
+		if(*p == '\n') lines++;
+		p++;
+	}
+	return p;
+}
+
+static const char *skipIdentScalar(const char *p, const char *end)
+{
+	while(p < end && isIdChar(*p)) p++;
+	return p;
+}
+
+static const char *skipDigitsScalar(const char *p, const char *end)
+{
+	while(p < end && isDigitChar(*p)) p++;
+	return p;
+}
+
+static const char *skipStringScalar(const char *p, const char *end, int &lines)
+{
+	while(p < end && *p != '\"' && *p != 0) {
+		if(*p == '\n') lines++;
+		p++;
+	}
+	return p;
+}
+
+static size_t countNewlinesScalar(const char *p, const char *end)
+{
+	size_t n = 0;
+	for(; p < end; p++)
+		if(*p == '\n') n++;
+	return n;
+}
+
+static size_t countQuotesScalar(const char *p, const char *end)
+{
+	size_t n = 0;
+	for(; p < end; p++)
+		if(*p == '\"') n++;
+	return n;
+}
+
+#ifdef SCAN_X86
+
+/********************************************************
+ SSE2 kernels, 16 bytes at a time
+********************************************************/
+
+// bytes of v in [lo, lo+span]
+static inline __m128i inRange16(__m128i v, char lo, char span)
+{
+	__m128i x = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+	return _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(span)), x);
+}
+
+static inline __m128i isSpace16(__m128i v)
+{
+	return _mm_or_si128(inRange16(v, '\t', '\r' - '\t'),
+	                    _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+}
+
+static inline __m128i isIdent16(__m128i v)
+{
+	__m128i alpha = inRange16(_mm_or_si128(v, _mm_set1_epi8(0x20)), 
+	                          'a', 'z' - 'a');
+	return _mm_or_si128(_mm_or_si128(alpha, inRange16(v, '0', 9)),
+	                    _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+}
+
+static inline unsigned newlines16(__m128i v)
+{
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+}
+
+// number of set bits of 'mask' below bit 'n'
+static inline int countBelow(unsigned mask, unsigned n)
+{
+	return __builtin_popcount(mask & ((1u << n) - 1));
+}
+
+static const char *skipSpaceSse2(const char *p, const char *end, int &lines)
+{
+	while(end - p >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		unsigned stop = ~_mm_movemask_epi8(isSpace16(v)) & 0xffff;
+		unsigned nl = newlines16(v);
+		if(stop) {
+			unsigned n = __builtin_ctz(stop);
+			lines += countBelow(nl, n);
+			return p + n;
+		}
+		lines += __builtin_popcount(nl);
+		p += 16;
+	}
+	return skipSpaceScalar(p, end, lines);
+}
+
+static const char *skipIdentSse2(const char *p, const char *end)
+{
+	while(end - p >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		unsigned stop = ~_mm_movemask_epi8(isIdent16(v)) & 0xffff;
+		if(stop) return p + __builtin_ctz(stop);
+		p += 16;
+	}
+	return skipIdentScalar(p, end);
+}
+
+static const char *skipDigitsSse2(const char *p, const char *end)
+{
+	while(end - p >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		unsigned stop = ~_mm_movemask_epi8(inRange16(v, '0', 9)) & 0xffff;
+		if(stop) return p + __builtin_ctz(stop);
+		p += 16;
+	}
+	return skipDigitsScalar(p, end);
+}
+
+static const char *skipStringSse2(const char *p, const char *end, int &lines)
+{
+	while(end - p >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		__m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\"')),
+		                           _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+		unsigned stop = _mm_movemask_epi8(hit);
+		unsigned nl = newlines16(v);
+		if(stop) {
+			unsigned n = __builtin_ctz(stop);
+			lines += countBelow(nl, n);
+			return p + n;
+		}
+		lines += __builtin_popcount(nl);
+		p += 16;
+	}
+	return skipStringScalar(p, end, lines);
+}
+
+static size_t countNewlinesSse2(const char *p, const char *end)
+{
+	size_t n = 0;
+	for(; end - p >= 16; p += 16)
+		n += __builtin_popcount(newlines16(_mm_loadu_si128((const __m128i *)p)));
+	return n + countNewlinesScalar(p, end);
+}
+
+static size_t countQuotesSse2(const char *p, const char *end)
+{
+	size_t n = 0;
+	for(; end - p >= 16; p += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		n += __builtin_popcount(
+			_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\"'))));
+	}
+	return n + countQuotesScalar(p, end);
+}
+
+/********************************************************
+ AVX2 kernels, 32 bytes at a time
+********************************************************/
+
+#define AVX2 __attribute__((target("avx2,popcnt,bmi")))
+
+AVX2 static inline __m256i inRange32(__m256i v, char lo, char span)
+{
+	__m256i x = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+	return _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(span)), x);
+}
+
+AVX2 static inline __m256i isSpace32(__m256i v)
+{
+	return _mm256_or_si256(inRange32(v, '\t', '\r' - '\t'),
+	                       _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+}
+
+AVX2 static inline __m256i isIdent32(__m256i v)
+{
+	__m256i alpha = inRange32(_mm256_or_si256(v, _mm256_set1_epi8(0x20)),
+	                          'a', 'z' - 'a');
+	return _mm256_or_si256(_mm256_or_si256(alpha, inRange32(v, '0', 9)),
+	                       _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+}
+
+AVX2 static inline unsigned newlines32(__m256i v)
+{
+	return _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+}
+
+AVX2 static const char *skipSpaceAvx2(const char *p, const char *end, 
+                                      int &lines)
+{
+	while(end - p >= 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)p);
+		unsigned stop = ~(unsigned)_mm256_movemask_epi8(isSpace32(v));
+		unsigned nl = newlines32(v);
+		if(stop) {
+			unsigned n = __builtin_ctz(stop);
+			lines += countBelow(nl, n);
+			return p + n;
+		}
+		lines += __builtin_popcount(nl);
+		p += 32;
+	}
+	return skipSpaceSse2(p, end, lines);
+}
+
+AVX2 static const char *skipIdentAvx2(const char *p, const char *end)
+{
+	while(end - p >= 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)p);
+		unsigned stop = ~(unsigned)_mm256_movemask_epi8(isIdent32(v));
+		if(stop) return p + __builtin_ctz(stop);
+		p += 32;
+	}
+	return skipIdentSse2(p, end);
+}
+
+AVX2 static const char *skipDigitsAvx2(const char *p, const char *end)
+{
+	while(end - p >= 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)p);
+		unsigned stop = ~(unsigned)_mm256_movemask_epi8(inRange32(v, '0', 9));
+		if(stop) return p + __builtin_ctz(stop);
+		p += 32;
+	}
+	return skipDigitsSse2(p, end);
+}
+
+AVX2 static const char *skipStringAvx2(const char *p, const char *end, 
+                                       int &lines)
+{
+	while(end - p >= 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)p);
+		__m256i hit = _mm256_or_si256(
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\"')),
+			_mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+		unsigned stop = _mm256_movemask_epi8(hit);
+		unsigned nl = newlines32(v);
+		if(stop) {
+			unsigned n = __builtin_ctz(stop);
+			lines += countBelow(nl, n);
+			return p + n;
+		}
+		lines += __builtin_popcount(nl);
+		p += 32;
+	}
+	return skipStringSse2(p, end, lines);
+}
+
+AVX2 static size_t countNewlinesAvx2(const char *p, const char *end)
+{
+	size_t n = 0;
+	for(; end - p >= 32; p += 32)
+		n += __builtin_popcount(
+			newlines32(_mm256_loadu_si256((const __m256i *)p)));
+	return n + countNewlinesSse2(p, end);
+}
+
+AVX2 static size_t countQuotesAvx2(const char *p, const char *end)
+{
+	size_t n = 0;
+	for(; end - p >= 32; p += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)p);
+		n += __builtin_popcount(_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\"'))));
+	}
+	return n + countQuotesSse2(p, end);
+}
+
+#undef AVX2
+
+#endif // SCAN_X86
+
+
+static const ScanKernels scalarKernels = {
+	skipSpaceScalar, skipIdentScalar, skipDigitsScalar, skipStringScalar,
+	countNewlinesScalar, countQuotesScalar
+};
+
+#ifdef SCAN_X86
+static const ScanKernels sse2Kernels = {
+	skipSpaceSse2, skipIdentSse2, skipDigitsSse2, skipStringSse2,
+	countNewlinesSse2, countQuotesSse2
+};
+
+static const ScanKernels avx2Kernels = {
+	skipSpaceAvx2, skipIdentAvx2, skipDigitsAvx2, skipStringAvx2,
+	countNewlinesAvx2, countQuotesAvx2
+};
+#endif
+
+ScanLevel bestScanLevel()
+{
+#ifdef SCAN_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt") &&
+	   __builtin_cpu_supports("bmi"))
+		return SCAN_AVX2;
+	if(__builtin_cpu_supports("sse2"))
+		return SCAN_SSE2;
+#endif
+	return SCAN_SCALAR;
+}
+
+const ScanKernels &scanKernels(ScanLevel level)
+{
+#ifdef SCAN_X86
+	switch(level) {
+	case SCAN_AVX2:		return avx2Kernels;
+	case SCAN_SSE2:		return sse2Kernels;
+	default:			break;
+	}
+#endif
+	return scalarKernels;
+}
+
+const ScanKernels &scanKernels()
+{
+	static const ScanKernels &best = scanKernels(bestScanLevel());
+	return best;
+}
@@ -0,0 +1,211 @@
+
+#include <lexer/tokenbuffer.h>
+#include <lexer/scan.h>
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <thread>
+#include <cstring>
+
+namespace {
+
+const char *TOO_LARGE = "input too large to buffer: 4GiB or more";
+
+}
+
+void TokenBuffer::fill(IBTLLexer &lexer)
+{
+	while(true) {
+		Token t = lexer.getToken();
+		if(lexer.offset() > MAX_OFFSET)
+			throw LexException(TOO_LARGE, lexer.line());
+		names.push_back(t.name);
+		attrs.push_back(t.attr);
+		offsets.push_back(lexer.offset());
+		lines.push_back(lexer.line());
+		if(hasLexeme(t.name, t.attr)) {
+			Lexeme l;
+			l.val = t.val;
+			if(t.name == TK_ID) l.sym = t.sym;
+			else l.num = t.num;
+			lexemes.push_back(l);
+		}
+		if(t.name == TK_EOF) break;
+	}
+}
+
+/********************************************************
+ parallel lexing
+********************************************************/
+
+namespace {
+
+// inputs are not split into chunks smaller than this
+const size_t MIN_CHUNK = 1 << 20;
+
+// runs fn(0) ... fn(n-1), each on its own thread
+template<class Fn>
+void parallelFor(size_t n, Fn fn)
+{
+	std::vector<std::thread> workers;
+	for(size_t i = 1; i < n; i++)
+		workers.emplace_back(fn, i);
+	fn(0);
+	for(std::thread &t : workers) t.join();
+}
+
+struct Slice
+{
+	size_t quotes;
+	size_t newlines;
+	bool nul;
+};
+
+struct Chunk
+{
+	size_t begin;
+	size_t end;
+	int line;		// line number at 'begin'
+	Interner interner;
+	TokenBuffer tokens;
+	std::exception_ptr error;
+};
+
+}
+
+/*
+	the input is cut into equal slices, which are prescanned in parallel
+	for quotes and newlines. Each chunk boundary is then moved forward
+	from a slice boundary to the next whitespace that lies outside a
+	string literal, found from the quote parity. Tokens never span such
+	whitespace, so every chunk lexes exactly like the same stretch of the
+	whole input. Each chunk gets its own lexer and interner, starting at
+	the right line number; the results are stitched together in order,
+	mapping the chunk symbol ids to ids of 'interner'.
+*/
+void TokenBuffer::fillParallel(const char *data, size_t size, Interner &interner,
+                               unsigned threads)
+{
+	if(size > MAX_OFFSET) throw LexException(TOO_LARGE, 1);
+
+	size_t n = std::min<size_t>(threads, size / MIN_CHUNK);
+	if(n <= 1) {
+		Reader rd(data, size);
+		IBTLLexer lexer(rd, interner);
+		fill(lexer);
+		return;
+	}
+
+	const ScanKernels &scan = scanKernels();
+	std::vector<size_t> bound(n + 1);
+	for(size_t i = 0; i <= n; i++) bound[i] = size / n * i;
+	bound[n] = size;
+
+	std::vector<Slice> slices(n);
+	parallelFor(n, [&](size_t i) {
+		const char *p = data + bound[i], *end = data + bound[i+1];
+		slices[i].quotes = scan.countQuotes(p, end);
+		slices[i].newlines = scan.countNewlines(p, end);
+		slices[i].nul = memchr(p, 0, end - p) != NULL;
+	});
+
+	// the lexer stops at the first '\0'. Such inputs are not worth
+	// splitting
+	for(const Slice &s : slices)
+		if(s.nul) {
+			Reader rd(data, size);
+			IBTLLexer lexer(rd, interner);
+			fill(lexer);
+			return;
+		}
+
+	// find the chunk boundaries
+	std::deque<Chunk> chunks(1);
+	chunks[0].begin = 0;
+	chunks[0].line = 1;
+	size_t quotes = 0, newlines = 0;
+	for(size_t i = 1; i < n; i++) {
+		quotes += slices[i-1].quotes;
+		newlines += slices[i-1].newlines;
+
+		bool inString = quotes % 2;
+		size_t lines = newlines;
+		size_t p = bound[i];
+		for(; p < size; p++) {
+			char c = data[p];
+			if(c == '\"') inString = !inString;
+			else if(!inString && isSpaceChar(c)) break;
+			if(c == '\n') lines++;
+		}
+
+		// a boundary already passed by the previous one is dropped
+		if(p >= size || p <= chunks.back().begin) continue;
+		chunks.back().end = p;
+		chunks.emplace_back();
+		chunks.back().begin = p;
+		chunks.back().line = 1 + lines;
+	}
+	chunks.back().end = size;
+
+	parallelFor(chunks.size(), [&](size_t i) {
+		Chunk &c = chunks[i];
+		try {
+			Reader rd(data, c.begin, c.end, c.line);
+			IBTLLexer lexer(rd, c.interner);
+			c.tokens.fill(lexer);
+		}
+		catch(LexException &) {
+			c.error = std::current_exception();
+		}
+	});
+	for(Chunk &c : chunks)
+		if(c.error) std::rethrow_exception(c.error);
+
+	// intern the chunk names in input order, which numbers them as the
+	// serial lexer would
+	std::vector<std::vector<SymbolId>> symbols(chunks.size());
+	for(size_t i = 0; i < chunks.size(); i++) {
+		Interner &local = chunks[i].interner;
+		for(SymbolId id = 0; id < local.size(); id++)
+			symbols[i].push_back(interner.intern(local.name(id)));
+	}
+
+	// every chunk but the last ends with a TK_EOF that is dropped
+	std::vector<size_t> tokPos(chunks.size() + 1), lexPos(chunks.size() + 1);
+	tokPos[0] = names.size();
+	lexPos[0] = lexemes.size();
+	for(size_t i = 0; i < chunks.size(); i++) {
+		TokenBuffer &t = chunks[i].tokens;
+		size_t count = t.size() - (i + 1 < chunks.size());
+		tokPos[i+1] = tokPos[i] + count;
+		lexPos[i+1] = lexPos[i] + t.lexemes.size();
+	}
+	names.resize(tokPos.back());
+	attrs.resize(tokPos.back());
+	offsets.resize(tokPos.back());
+	lines.resize(tokPos.back());
+	lexemes.resize(lexPos.back());
+
+	parallelFor(chunks.size(), [&](size_t i) {
+		TokenBuffer &t = chunks[i].tokens;
+		size_t count = tokPos[i+1] - tokPos[i];
+		std::copy_n(t.names.begin(), count, names.begin() + tokPos[i]);
+		std::copy_n(t.attrs.begin(), count, attrs.begin() + tokPos[i]);
+		std::copy_n(t.offsets.begin(), count, offsets.begin() + tokPos[i]);
+		std::copy_n(t.lines.begin(), count, lines.begin() + tokPos[i]);
+
+		// EOF has no lexeme, so all of them are kept
+		size_t l = lexPos[i], tok = 0;
+		for(Lexeme lex : t.lexemes) {
+			// find the token that owns this lexeme to tell ids apart
+			while(!hasLexeme((TokenName)t.names[tok], (TokenAttr)t.attrs[tok]))
+				tok++;
+			if(t.names[tok] == TK_ID) {
+				lex.sym = symbols[i][lex.sym];
+				lex.val = interner.name(lex.sym);
+			}
+			lexemes[l++] = lex;
+			tok++;
+		}
+	});
+}
@@ -0,0 +1,48 @@
+#include <lexer/tokenring.h>
+
+PipeLexer::PipeLexer(IBTLLexer &lexer) :
+	Lexer(),
+	lexer(lexer),
+	ring(RING_SIZE),
+	error(),
+	cancelled(false),
+	last(TK_EOF),
+	curLine(1),
+	done(false),
+	producer()
+{
+	// started last, once every member it uses is initialized
+	producer = std::thread(&PipeLexer::produce, this);
+}
+
+PipeLexer::~PipeLexer()
+{
+	cancelled.store(true, std::memory_order_relaxed);
+	producer.join();
+}
+
+/*
+	the lexer thread. Pushes every token up to and including TK_EOF. If
+	the lexer throws, the exception is saved and a TK_EOF is pushed in
+	place of the rest of the input.
+*/
+void PipeLexer::produce()
+{
+	Slot s;
+	do {
+		try {
+			s.tok = lexer.getToken();
+		}
+		catch(LexException &) {
+			error = std::current_exception();
+			s.tok = Token(TK_EOF);
+		}
+		s.line = lexer.line();
+
+		int spins = 0;
+		while(!ring.tryPush(s)) {
+			if(cancelled.load(std::memory_order_relaxed)) return;
+			wait(spins);
+		}
+	} while(s.tok.name != TK_EOF);
+}
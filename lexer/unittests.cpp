@@ -1,9 +1,13 @@
 
-#include "reader.h"
-#include "lexer.h"
-#include "token.h"
+#include <lexer/reader.h>
+#include <lexer/lexer.h>
+#include <lexer/token.h>
+#include <lexer/scan.h>
 #include <iostream>
 #include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
 #include <assert.h>
 
 using namespace std;
@@ -17,20 +21,18 @@ public:
 		string in = "hello        world";
 		istringstream str(in);
 		Reader obj(&str);
-		
-		string exp = "helloworld";
+
 		char c;
-		const char *lex;
 
-		for(int i = 0; i < exp.size(); i++) {
+		for(size_t i = 0; i < in.size(); i++) {
 			c = obj.getChar();
-			assert(c == exp[i]);
+			assert(c == in[i]);
 		}
 
 		assert(obj.getChar() == 0);
+		obj.putChar();
 
-		lex = obj.getLexeme();
-		assert(string(lex) == exp);	
+		assert(obj.getLexeme() == in);
 	}
 
 	void putChar()
@@ -38,21 +40,19 @@ public:
 		string in = "abcdefg";
 		istringstream str(in);
 		Reader obj(&str);
-		
-		
+
+
 		for(int i = 0; i < 5; i++)
 			obj.getChar();
 		obj.putChar();
 
-		const char *lex = obj.getLexeme();
-		assert(string(lex) == string("abcd"));
+		assert(obj.getLexeme() == "abcd");
 		obj.clearLexeme();
-		
+
 		obj.getChar();
 		obj.getChar();
 		obj.getChar();
-		lex = obj.getLexeme();
-		assert(string(lex) == string("efg"));
+		assert(obj.getLexeme() == "efg");
 	}
 };
 
@@ -66,34 +66,34 @@ public:
 		string in = "\"hello world\"\"next\"";
 		istringstream str(in);
 		Reader read(&str);
+		Interner names;
 		read.getChar();
 
-		IBTLLexer lex(read);
-		LiteralToken *tok = (LiteralToken *) lex.readString();
+		IBTLLexer lex(read, names);
+		Token tok = lex.readString();
+		string val(tok.val);
 		read.clearLexeme();
 		read.getChar();
-		LiteralToken *next = (LiteralToken *) lex.readString();
-		assert(tok->val == string("\"hello world\""));
-		assert(next->val == string("\"next\""));
+		Token next = lex.readString();
+		assert(val == "\"hello world\"");
+		assert(next.val == "\"next\"");
 	}
-	
 
 	void readNumber()
 	{
 		string in = "123+4.75";
-		istringstream str(in);
-		Reader read(&str);
-		read.getChar();
+		Reader read(in.data(), in.size());
+		Interner names;
 
-		IBTLLexer lex(read);
-		LiteralToken *tok = (LiteralToken *) lex.readNumber();
+		IBTLLexer lex(read, names);
+		Token tok = lex.readNumber(read.getChar());
 		read.clearLexeme();
-		Token *op = lex.readOp(read.getChar());
+		Token op = lex.readOp(read.getChar());
 		read.clearLexeme();
-		LiteralToken *next = (LiteralToken *) lex.readNumber();
-		cout << tok->val << endl;
-		cout << next->val << endl;
-		assert(op->name == TK_PLUS);
+		Token next = lex.readNumber(read.getChar());
+		assert(tok.attr == AT_INT_DEC && tok.num.i == 123);
+		assert(op.name == TK_BINOP && op.attr == AT_PLUS);
+		assert(next.attr == AT_REAL && next.num.r == 4.75);
 	}
 
 
@@ -102,26 +102,27 @@ public:
 		string in = "<==>=!=";
 		istringstream str(in);
 		Reader read(&str);
+		Interner names;
 		char c;
 
-		IBTLLexer lex(read);
+		IBTLLexer lex(read, names);
 		c = read.getChar();
-		Token *one = lex.readRelop(c);
+		Token one = lex.readRelop(c);
 		read.clearLexeme();
 		c = read.getChar();
-		Token *two = lex.readRelop(c);
+		Token two = lex.readRelop(c);
 		read.clearLexeme();
 		c = read.getChar();
-		Token *three = lex.readRelop(c);
+		Token three = lex.readRelop(c);
 		read.clearLexeme();
 		c = read.getChar();
-		Token *four = lex.readRelop(c);
+		Token four = lex.readRelop(c);
 		read.clearLexeme();
 
-		assert(one->name == TK_LE);
-		assert(two->name == TK_EQ);
-		assert(three->name == TK_GE);
-		assert(four->name == TK_NE);
+		assert(one.attr == AT_LE);
+		assert(two.attr == AT_EQ);
+		assert(three.attr == AT_GE);
+		assert(four.attr == AT_NE);
 	}
 
 	void getToken1()
@@ -129,19 +130,175 @@ public:
 		string in = "[[if a b c<=5+7.563]+1]";
 		istringstream str(in);
 		Reader read(&str);
-		
-		IBTLLexer lex(read);
-		Token *tok;
-		while(tok = lex.getToken()) {
-			cout << tok->toString() << endl;
+		Interner names;
+
+		IBTLLexer lex(read, names);
+		Token tok;
+		while((tok = lex.getToken()).name != TK_EOF) {
+			cout << tok << endl;
 		}
 	}
-	
+
 };
 
-int main(int argc, char *argv[])
+
+/*
+	runs the kernels of every level the cpu supports against the scalar
+	ones, on runs of every length up to 80 at every alignment within a
+	32-byte block. So runs start and end on both sides of the 16- and
+	32-byte boundaries the vector loops step over
+*/
+class ScanTest
 {
+	enum Kernel {
+		K_SPACE,
+		K_IDENT,
+		K_DIGITS,
+		K_STRING
+	};
+
+	static const int MAX_RUN = 80;
+	static const int ALIGNS = 32;
+
+	// characters each kernel skips, and ones it stops at
+	static const char *runChars(Kernel k)
+	{
+		switch(k) {
+		case K_SPACE:	return " \t\n\r\v\f";
+		case K_IDENT:	return "azAZ_09qM";
+		case K_DIGITS:	return "0123456789";
+		default:		return "ab \n[]\t'x";
+		}
+	}
+
+	static const char *stopChars(Kernel k)
+	{
+		switch(k) {
+		case K_SPACE:	return "x[\"";
+		case K_IDENT:	return " [\n\"";
+		case K_DIGITS:	return "a.\n ";
+		default:		return "\"";
+		}
+	}
+
+	static const char *run(const ScanKernels &scan, Kernel k, const char *p,
+	                       const char *end, int &lines)
+	{
+		switch(k) {
+		case K_SPACE:	return scan.skipSpace(p, end, lines);
+		case K_IDENT:	return scan.skipIdent(p, end);
+		case K_DIGITS:	return scan.skipDigits(p, end);
+		default:		return scan.skipString(p, end, lines);
+		}
+	}
+
+	unsigned seed;
+
+	char pick(const char *chars)
+	{
+		seed = seed * 1103515245 + 12345;
+		return chars[(seed >> 16) % strlen(chars)];
+	}
+
+	/*
+		skips the run at 'align' in 'in' with the kernels of 'level' and
+		with the scalar ones, which must both stop at 'expect'
+	*/
+	void check(ScanLevel level, Kernel k, const vector<char> &in,
+	           int align, size_t expect)
+	{
+		const char *p = in.data() + align, *end = in.data() + in.size();
+		int lines = 0, scalarLines = 0;
+		const char *stop = run(scanKernels(level), k, p, end, lines);
+		const char *scalar = run(scanKernels(SCAN_SCALAR), k, p, end,
+		                         scalarLines);
+		assert(scalar == in.data() + expect);
+		assert(stop == scalar);
+		assert(lines == scalarLines);
+		assert(lines == count(p, stop, '\n'));
+	}
+
+	void counts(ScanLevel level, const vector<char> &in, int align)
+	{
+		const ScanKernels &scan = scanKernels(level);
+		const ScanKernels &scalar = scanKernels(SCAN_SCALAR);
+		const char *p = in.data() + align, *end = in.data() + in.size();
+		assert(scan.countNewlines(p, end) == scalar.countNewlines(p, end));
+		assert(scan.countQuotes(p, end) == scalar.countQuotes(p, end));
+		assert(scalar.countNewlines(p, end) == (size_t)count(p, end, '\n'));
+		assert(scalar.countQuotes(p, end) == (size_t)count(p, end, '"'));
+	}
+
+public:
+
+	ScanTest() :
+		seed(1)
+	{}
+
+	void kernels(ScanLevel level)
+	{
+		for(int k = K_SPACE; k <= K_STRING; k++)
+		for(int align = 0; align < ALIGNS; align++)
+		for(int len = 0; len <= MAX_RUN; len++) {
+			Kernel kernel = (Kernel)k;
+			vector<char> in(align, '@');
+			for(int i = 0; i < len; i++)
+				in.push_back(pick(runChars(kernel)));
+			size_t expect = in.size();
+
+			// the input ends in the middle of the run
+			check(level, kernel, in, align, expect);
+			counts(level, in, align);
+
+			// the character ending the run is the last byte
+			in.push_back(pick(stopChars(kernel)));
+			check(level, kernel, in, align, expect);
+			counts(level, in, align);
+
+			// more of the run follows the character that ends it
+			in.push_back(pick(runChars(kernel)));
+			check(level, kernel, in, align, expect);
+		}
+
+		// a newline in the last byte of a run that crosses lines
+		for(int len = 1; len <= MAX_RUN; len++) {
+			vector<char> space(len, ' '), str(len, 'a');
+			space.back() = str.back() = '\n';
+			check(level, K_SPACE, space, 0, len);
+			check(level, K_STRING, str, 0, len);
+			counts(level, str, 0);
+		}
+
+		// a string stops at a NUL as well as a quote
+		vector<char> in(40, 'a');
+		in[33] = 0;
+		check(level, K_STRING, in, 0, 33);
+	}
+
+	// runs kernels() on each level the running cpu supports
+	void allLevels()
+	{
+		ScanLevel best = bestScanLevel();
+		kernels(SCAN_SCALAR);
+		if(best >= SCAN_SSE2) kernels(SCAN_SSE2);
+		if(best >= SCAN_AVX2) kernels(SCAN_AVX2);
+	}
+};
+
+int main()
+{
+	ReaderTest r;
+	r.getChar();
+	r.putChar();
+
 	IBTLLexerTest t;
+	t.readString();
+	t.readNumber();
+	t.readRelop();
 	t.getToken1();
+
+	ScanTest s;
+	s.allLevels();
+	cout << "all lexer unit tests passed" << endl;
 }
 
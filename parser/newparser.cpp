@@ -1,337 +1,306 @@
 
 #include <parser/newparser.h>
+#include <parser/treedump.h>
+#include <type_traits>
 
-void toStream(std::ostream &str, Node &node, int indent)
+NodeId Ast::add(Node *n, NodeKind k, int ln, NodeList children)
 {
-	std::string ind(indent, '\t');
-	if(node.isToken)
-		str << ind << node.name() << std::endl;
-	else {
-		str << ind << "[" << node.name() << std::endl;
-		for(auto iter = node.children.cbegin(); iter != node.children.cend();
-		    iter++)
-			toStream(str, **iter, indent+1);
-		str << ind << "]" << std::endl;
+	NodeId id = kind.size();
+	kind.push_back(k);
+	type.push_back(TP_NONE);
+	binding.push_back(NO_SYMBOL);
+	line.push_back(ln);
+	firstChild.push_back(childIds.size());
+	childCount.push_back(children.count);
+	node.push_back(n);
+	for(size_t i = 0; i < children.count; i++)
+		childIds.push_back(children[i]->nodeId());
+	return id;
+}
+
+void Ast::reserve(size_t nodes, size_t children)
+{
+	nodes += size();
+	kind.resize(nodes);
+	type.resize(nodes);
+	binding.resize(nodes, NO_SYMBOL);
+	line.resize(nodes);
+	firstChild.resize(nodes);
+	childCount.resize(nodes);
+	node.resize(nodes);
+	childIds.resize(childIds.size() + children);
+}
+
+void Ast::splice(Ast &part, NodeId base, size_t childBase)
+{
+	for(size_t i = 0; i < part.size(); i++) {
+		kind[base + i] = part.kind[i];
+		type[base + i] = part.type[i];
+		binding[base + i] = part.binding[i];
+		line[base + i] = part.line[i];
+		firstChild[base + i] = part.firstChild[i] + childBase;
+		childCount[base + i] = part.childCount[i];
+		Node *n = part.node[i];
+		n->ast = this;
+		n->id += base;
+		node[base + i] = n;
 	}
+	for(size_t i = 0; i < part.childIds.size(); i++)
+		childIds[childBase + i] = part.childIds[i] + base;
+
+	part.kind.clear();
+	part.type.clear();
+	part.binding.clear();
+	part.line.clear();
+	part.firstChild.clear();
+	part.childCount.clear();
+	part.node.clear();
+	part.childIds.clear();
 }
 
 std::ostream &operator <<(std::ostream &str, Node &node)
 {
-	toStream(str, node, 0);
+	TreeDumper(str).dump(&node);
 	return str;
 }
 
 
 
-// scope (S)
-
-ProgramNode *IBTLParser::T() {
-	discard(TK_OBRAK);
-	ProgramNode *t = new ProgramNode(scopelist(), line());
-	discard(TK_CBRAK);
-	discard(TK_EOF);
-	return t;
-}
-
-ContainerScopeNode *IBTLParser::scopelist() {
-	return scopelist(new ContainerScopeNode(line()));
-}
-
-ContainerScopeNode *IBTLParser::scopelist(ContainerScopeNode *sc) {
-	sc->children.push_back(scope());
-	return scopelist_p(sc);
-}
-
-ContainerScopeNode *IBTLParser::scopelist_p(ContainerScopeNode *sc) {
-	if(is(TK_CBRAK)) return sc;
-	if(is(TK_OBRAK) || is(TK_ID) || is(TK_CONSTANT))
-		return scopelist(sc);
-	err("unterminated list of scopes");
-}
-
-ScopeNode *IBTLParser::scope() {
-	if(is(TK_CONSTANT) || is(TK_ID))
-		return expr(); // TODO: might want different rule here
-	if(is(TK_OBRAK))
-		return scope1();
-	err("invalid scope");
-}
-
-ScopeNode *IBTLParser::scope1() {
-	discard(TK_OBRAK);
-	return scope_p();
-}
-
-ScopeNode *IBTLParser::scope_p() {
-	if(is(TK_OBRAK) || is(TK_CONSTANT))
-		return scope_p3();
-	if(is(TK_CBRAK))	return scope_p2();
-	return scope_p1();
+/*
+	runs the LL(1) table from grammar.h. Each symbol popped off the parse
+	stack either matches the current token, expands a rule into the
+	production that the current token predicts, or builds a node from the
+	top of the value stack.
+*/
+template<class Source>
+ProgramNode *IBTLParser<Source>::parse()
+{
+	cur = lexer.getToken();
+	run(R_PROGRAM);
+	return pop<ProgramNode>();
 }
 
-ContainerScopeNode *IBTLParser::scope_p3() {
-	ContainerScopeNode *t = scopelist();
-	discard(TK_CBRAK);
-	return t;
+template<class Source>
+void IBTLParser<Source>::parseScopes(size_t count, std::vector<Node *> &out)
+{
+	cur = lexer.getToken();
+	for(size_t i = 0; i < count; i++)
+		run(R_SCOPE);
+	out.assign(pending.begin(), pending.end());
+	pending.clear();
 }
 
-ScopeNode *IBTLParser::scope_p2() {
-    int ln = line();
-	discard(TK_CBRAK);
-	return new ContainerScopeNode(ln);
+template<class Source>
+ContainerScopeNode *IBTLParser<Source>::parseBody()
+{
+	cur = lexer.getToken();
+	run(R_SCOPELIST);
+	require(TK_CBRAK);
+	return pop<ContainerScopeNode>();
 }
 
-ScopeNode *IBTLParser::scope_p1() {
-	return exprsuffix();
+ContainerScopeNode *LazyBodies::parse(Ast &ast, uint32_t pos, uint32_t lex)
+{
+	TokenCursor cursor(tokens, pos, lex);
+	IBTLParser<TokenCursor> parser(cursor, ast);
+	return parser.parseBody();
 }
 
-// expr
-
-ExprNode *IBTLParser::expr() {
-	if(is(TK_OBRAK)) {
-		discard(TK_OBRAK);
-		return exprsuffix();
+/*
+	parses one 'start' and leaves its node on top of the value stack
+*/
+template<class Source>
+void IBTLParser<Source>::run(Rule start)
+{
+	stack.clear();
+	stack.push_back(Sym::rule(start));
+
+	while(!stack.empty()) {
+		Sym s = popBack(stack);
+		switch(s.kind) {
+		case SY_DISCARD:	discard((TokenName)s.arg); break;
+		case SY_TAKE:		pending.push_back(take((TokenName)s.arg)); break;
+		case SY_RULE:		expand((Rule)s.arg); break;
+		case SY_ACTION:		reduce((Action)s.arg); break;
+		}
 	}
-	if(is(TK_CONSTANT)) return constant();
-	if(is(TK_ID)) return id();
-	err("invalid expr");
-}
-
-ExprNode *IBTLParser::exprsuffix() {
-	if(is(TK_BINOP) || is(TK_UNOP) || is(TK_MINUS) || is(TK_ASSIGN) ||
-       is(TK_ID))
-		return opersuffix();
-	if(is(TK_LET) || is(TK_PRINT) || is(TK_IF) || is(TK_WHILE))
-		return stmtsuffix();
-	err("invalid expr");
-}
-
-// oper
-
-OperNode *IBTLParser::oper() {
-	if(is(TK_OBRAK)) 	return oper1();
-	if(is(TK_CONSTANT)) 	return constant();
-	if(is(TK_ID)) 		return id(); 
-	err("invalid oper");
-}
-
-OperNode *IBTLParser::oper1() {
-	discard(TK_OBRAK);
-	return opersuffix();
-} 
-
-OperNode *IBTLParser::opersuffix() {
-	if(is(TK_BINOP))	return binop();
-	if(is(TK_UNOP))		return unop();
-	if(is(TK_MINUS))	return minus();
-	if(is(TK_ASSIGN))	return assign();
-    if(is(TK_ID))       return call();
-	err("invalid oper");
-}
-
-BinopNode *IBTLParser::binop() {
-	BinopNode *t = new BinopNode(take(TK_BINOP), oper(), oper(), line());
-	discard(TK_CBRAK);
-	return t;
-}
-
-UnopNode *IBTLParser::unop() {
-	UnopNode *t = new UnopNode(take(TK_UNOP), oper(), line());
-	discard(TK_CBRAK);
-	return t;
-}
-
-OperNode *IBTLParser::minus() {
-	TokNode *op = take(TK_MINUS);
-	OperNode *left = oper();
-	OperNode *right = minus_p();
-	if(right) return new BinopNode(op, left, right, line());
-	else return new UnopNode(op, left, line());
-}
-
-OperNode *IBTLParser::minus_p() {
-	if(is(TK_CBRAK))	return minus_p2();
-	return minus_p1();
-}
-
-OperNode *IBTLParser::minus_p1() {
-	OperNode *right = oper();
-	discard(TK_CBRAK);
-	return right;
-}
-
-OperNode *IBTLParser::minus_p2() {
-	discard(TK_CBRAK);
-	return NULL;
-}
-
-CallNode *IBTLParser::call() {
-    CallNode *t = new CallNode(line());
-    t->children.push_back(take(TK_ID));
-    while(!is(TK_CBRAK))
-        t->children.push_back(oper());
-    discard(TK_CBRAK);
-    return t;
-}
-
-TokNode *IBTLParser::constant() {
-	return take(TK_CONSTANT);
-}
-
-TokNode *IBTLParser::id() {
-	return take(TK_ID);
-}
-
-AssignNode *IBTLParser::assign() {
-	discard(TK_ASSIGN);
-	AssignNode *t = new AssignNode(id(), oper(), line());
-	discard(TK_CBRAK);
-	return t;
-}
-
-// stmts
-
-StmtNode *IBTLParser::stmtsuffix() {
-	if(is(TK_IF)) 		return ifstmts();
-	if(is(TK_WHILE)) 	return whilestmts();
-	if(is(TK_LET)) 		return letstmts();
-	if(is(TK_PRINT)) 	return printstmts();
-	err("invalid statement");	
-}
-
-IfNode *IBTLParser::ifstmts() {
-	discard(TK_IF);
-	IfNode *t = new IfNode(line(), expr(), expr());
-	ExprNode *elseStmt = ifstmts_p();	
-	if(elseStmt)
-		t->children.push_back(elseStmt);
-	discard(TK_CBRAK);
-	return t;
-}
-
-ExprNode *IBTLParser::ifstmts_p() {
-	if(is(TK_OBRAK) || is(TK_ID) || is(TK_CONSTANT))
-		 return expr();
-	if(is(TK_CBRAK)) return NULL;
-	err("invalid if statement");
-}
-
-WhileNode *IBTLParser::whilestmts() {
-	discard(TK_WHILE);
-	WhileNode *t = new WhileNode(expr(), exprlist(), line());
-	discard(TK_CBRAK);
-	return t;
-}
-
-StmtNode *IBTLParser::letstmts() {
-	discard(TK_LET);
-	discard(TK_OBRAK);
-    discard(TK_OBRAK);
-    TokNode *firstId = take(TK_ID);
-    return letstmts_p(firstId);
-}
-
-StmtNode *IBTLParser::letstmts_p(TokNode *firstId) {
-    if(is(TK_TYPE)) {
-        // regular let statements
-        VarListNode *vars = new VarListNode(line());
-        vars->children.push_back(firstId);
-        vars->children.push_back(take(TK_TYPE));
-        discard(TK_CBRAK);
-        LetNode *t = new LetNode(varlist(vars), line());
-        discard(TK_CBRAK);
-        discard(TK_CBRAK);
-        return t;
-    }
-    // functions
-    if(is(TK_ID)) return funcstmts(firstId);
-    err("expected id or type in let statement");
-}
-
-FunctionNode *IBTLParser::funcstmts(TokNode *firstId) {
-    FunctionNode *t = new FunctionNode(line());
-    IdListNode *ids = new IdListNode(line());
-    ids->children.push_back(firstId);
-    t->children.push_back(idlist(ids));
-    discard(TK_CBRAK);
-    discard(TK_OBRAK);
-    t->children.push_back(typelist());
-    discard(TK_CBRAK);
-    discard(TK_CBRAK);
-    t->children.push_back(scopelist());
-    discard(TK_CBRAK);
-    return t;
-}
-
-PrintNode *IBTLParser::printstmts() {
-	discard(TK_PRINT);
-	PrintNode *t = new PrintNode(oper(), line());
-	discard(TK_CBRAK);
-	return t;
-}
-
-// exprlist, operlist, idlist, typelist & varlist
-
-ExprListNode *IBTLParser::exprlist() {
-	return exprlist(new ExprListNode(line()));
-}
-
-ExprListNode *IBTLParser::exprlist(ExprListNode *list) {
-	list->children.push_back(expr());
-	return exprlist_p(list);
-}
-
-ExprListNode *IBTLParser::exprlist_p(ExprListNode *list) {
-	if(is(TK_OBRAK) || is(TK_CONSTANT) || is(TK_ID))
-		return exprlist(list);
-	if(is(TK_CBRAK))	return list;
-	err("invalid exprlist");
-}
-
-VarListNode *IBTLParser::varlist() {
-	return varlist(new VarListNode(line()));
-}
-
-VarListNode *IBTLParser::varlist(VarListNode *list) {
-    if(is(TK_OBRAK))    return varlist_p(list);
-    if(is(TK_CBRAK))    return list;
-    err("invalid varlist");	
 }
 
-VarListNode *IBTLParser::varlist_p(VarListNode *list) {
-	discard(TK_OBRAK);
-	list->children.push_back(take(TK_ID));
-	list->children.push_back(take(TK_TYPE));
-	discard(TK_CBRAK);
-    return varlist(list);
-}
-
-IdListNode *IBTLParser::idlist(IdListNode *list) {
-    if(is(TK_ID))       return idlist_p(list);
-    if(is(TK_CBRAK))    return list;
-    err("invalid idlist");
-
-    
-}
+template<class Source>
+void IBTLParser<Source>::expand(Rule r)
+{
+	uint8_t p = grammar.predict[r][cur.name];
+	if(p == P_ERROR) err(grammar.error[r]);
 
-IdListNode *IBTLParser::idlist_p(IdListNode *list) {
-    list->children.push_back(take(TK_ID));
-    return idlist(list);
+	// push in reverse so that the first symbol is on top
+	const Production &prod = grammar.prods[p];
+	for(int i = prod.len; i-- > 0;)
+		stack.push_back(prod.syms[i]);
 }
 
-TypeListNode *IBTLParser::typelist() {
-    return typelist(new TypeListNode(line()));
-}
+template<class Source>
+void IBTLParser<Source>::reduce(Action a)
+{
+	switch(a) {
+	case A_LINE:
+		lines.push_back(line());
+		break;
+	case A_MARK:
+		marks.push_back(pending.size());
+		break;
+	case A_MARK_TOP:
+		marks.push_back(pending.size() - 1);
+		break;
+	case A_NULL:
+		pending.push_back(NULL);
+		break;
+
+	case A_PROGRAM: {
+		ContainerScopeNode *sc = pop<ContainerScopeNode>();
+		pending.push_back(make<ProgramNode>(sc, line()));
+		break;
+	}
+	case A_CONTAINER: {
+		int ln = popBack(lines);
+		pending.push_back(makeList<ContainerScopeNode>(popBack(marks), ln));
+		break;
+	}
+	case A_EXPRLIST: {
+		int ln = popBack(lines);
+		pending.push_back(makeList<ExprListNode>(popBack(marks), ln));
+		break;
+	}
+	case A_VARLIST: {
+		int ln = popBack(lines);
+		pending.push_back(makeList<VarListNode>(popBack(marks), ln));
+		break;
+	}
+	case A_IDLIST: {
+		// the function node that follows is on the same line
+		int ln = lines.back();
+		pending.push_back(makeList<IdListNode>(popBack(marks), ln));
+		break;
+	}
+	case A_TYPELIST: {
+		int ln = popBack(lines);
+		pending.push_back(makeList<TypeListNode>(popBack(marks), ln));
+		break;
+	}
+	case A_CALL: {
+		int ln = popBack(lines);
+		CallNode *call = makeList<CallNode>(popBack(marks), ln);
+		if(lazy) lazy->countCall(call->funcId()->symbol());
+		pending.push_back(call);
+		break;
+	}
 
-TypeListNode *IBTLParser::typelist(TypeListNode *list) {
-    list->children.push_back(take(TK_TYPE));
-    return typelist_p(list);
+	case A_BINOP: {
+		OperNode *right = pop<OperNode>();
+		OperNode *left = pop<OperNode>();
+		TokNode *op = pop<TokNode>();
+		pending.push_back(make<BinopNode>(op, left, right, line()));
+		break;
+	}
+	case A_UNOP: {
+		OperNode *left = pop<OperNode>();
+		TokNode *op = pop<TokNode>();
+		pending.push_back(make<UnopNode>(op, left, line()));
+		break;
+	}
+	case A_ASSIGN: {
+		OperNode *value = pop<OperNode>();
+		TokNode *target = pop<TokNode>();
+		pending.push_back(make<AssignNode>(target, value, line()));
+		break;
+	}
+	case A_IF: {
+		ExprNode *elseStmt = pop<ExprNode>();
+		ExprNode *then = pop<ExprNode>();
+		ExprNode *cond = pop<ExprNode>();
+		int ln = popBack(lines);
+		pending.push_back(make<IfNode>(ln, cond, then, elseStmt));
+		break;
+	}
+	case A_WHILE: {
+		ExprListNode *body = pop<ExprListNode>();
+		ExprNode *cond = pop<ExprNode>();
+		pending.push_back(make<WhileNode>(cond, body, line()));
+		break;
+	}
+	case A_LET: {
+		VarListNode *vars = pop<VarListNode>();
+		pending.push_back(make<LetNode>(vars, line()));
+		break;
+	}
+	case A_BODY:
+		if(!skipBody()) stack.push_back(Sym::rule(R_SCOPELIST));
+		break;
+	case A_FUNCTION: {
+		ContainerScopeNode *body = pop<ContainerScopeNode>();
+		TypeListNode *types = pop<TypeListNode>();
+		IdListNode *ids = pop<IdListNode>();
+		int ln = popBack(lines);
+		if(body)
+			pending.push_back(make<FunctionNode>(ln, ids, types, body));
+		else {
+			// a skipped body; see skipBody()
+			uint32_t lex = popBack(marks);
+			uint32_t pos = popBack(marks);
+			pending.push_back(make<FunctionNode>(ln, ids, types, lazy, 
+			                                     pos, lex));
+		}
+		break;
+	}
+	case A_PRINT: {
+		OperNode *value = pop<OperNode>();
+		pending.push_back(make<PrintNode>(value, line()));
+		break;
+	}
+	}
 }
 
-TypeListNode *IBTLParser::typelist_p(TypeListNode *list) {
-    if(is(TK_TYPE))     return typelist(list);
-    if(is(TK_CBRAK))    return list;
-    err("invalid typelist");
+/*
+	in a lazy parse, skips the function body that starts at the current
+	token, up to the ']' that closes the function, counting the calls in
+	it. Pushes a NULL body and records where the body starts for
+	A_FUNCTION. Returns false, with nothing skipped, if the body should
+	be parsed now: the parse is not lazy, or the body is empty or never
+	closed, so that the parser reports the error.
+*/
+template<class Source>
+bool IBTLParser<Source>::skipBody()
+{
+	if constexpr (std::is_same<Source, TokenCursor>::value) {
+		if(!lazy || is(TK_CBRAK) || is(TK_EOF)) return false;
+
+		// 'cur' has already been taken from the cursor
+		size_t pos = lexer.position() - 1;
+		size_t lex = lexer.lexemePosition() - 
+		             TokenBuffer::hasLexeme(cur.name, cur.attr);
+
+		int depth = 0;
+		TokenName prev = TK_EOF;
+		while(depth > 0 || !is(TK_CBRAK)) {
+			if(is(TK_EOF)) {
+				lexer.seek(pos, lex);
+				cur = lexer.getToken();
+				return false;
+			}
+			if(is(TK_OBRAK)) depth++;
+			else if(is(TK_CBRAK)) depth--;
+			else if(is(TK_ID) && prev == TK_OBRAK) lazy->countCall(cur.sym);
+			prev = cur.name;
+			cur = lexer.getToken();
+		}
+
+		pending.push_back(NULL);
+		marks.push_back(pos);
+		marks.push_back(lex);
+		return true;
+	}
+	return false;
 }
 
-
+template class IBTLParser<IBTLLexer>;
+template class IBTLParser<TokenCursor>;
+template class IBTLParser<PipeLexer>;
@@ -0,0 +1,147 @@
+
+#include <parser/parallelparse.h>
+#include <parser/newparser.h>
+#include <lexer/bracketindex.h>
+#include <workpool.h>
+#include <algorithm>
+#include <deque>
+#include <exception>
+
+namespace {
+
+// smaller inputs are parsed serially
+const size_t MIN_TOKENS = 1 << 16;
+
+// groups of top level items per thread, so that stealing can even out
+// groups of different cost
+const size_t TASKS_PER_THREAD = 8;
+
+struct Part
+{
+	Ast ast;
+	std::vector<Node *> roots;
+	std::exception_ptr error;
+	bool complete;
+
+	Part() :
+		ast(),
+		roots(),
+		error(),
+		complete(false)
+	{}
+};
+
+/*
+	returns NULL if the program does not have the shape that can be
+	split up, or if a group did not end where the bracket index says it
+	should. The serial parser then decides what is wrong with it.
+
+	only the top level scope list is split. Its items are whole subtrees
+	that end up side by side under the nodes made here, so the groups can
+	be spliced in as they are. The expression list of a while body is a
+	different nonterminal, inside a node the serial parser builds:
+	splitting it would need a parser entry point per list kind and a
+	splice into the middle of a finished tree. A program with most of its
+	tokens in one body still parses correctly, only on one thread.
+*/
+ProgramNode *parseSplit(TokenBuffer &tokens, Ast &ast, unsigned threads)
+{
+	size_t n = tokens.size();
+	BracketIndex index(tokens);
+	if(!index.balanced || tokens.names[0] != TK_OBRAK ||
+	   index.match[0] != n - 2 || tokens.names[n-1] != TK_EOF)
+		return NULL;
+
+	// the first token of each top level item, and the closing bracket
+	std::vector<uint32_t> starts;
+	for(uint32_t i = 1; i < n - 2;) {
+		starts.push_back(i);
+		TokenName name = (TokenName)tokens.names[i];
+		if(name == TK_OBRAK) i = index.match[i] + 1;
+		else if(name == TK_ID || name == TK_CONSTANT) i++;
+		else return NULL;
+	}
+	size_t items = starts.size();
+	starts.push_back(n - 2);
+	if(items < 2) return NULL;
+
+	// group the items into tasks of about the same number of tokens
+	size_t tasks = std::min(items, threads * TASKS_PER_THREAD);
+	std::vector<size_t> first(tasks + 1);
+	for(size_t t = 1; t < tasks; t++) {
+		uint32_t target = 1 + (n - 3) * t / tasks;
+		first[t] = std::lower_bound(starts.begin(), starts.begin() + items,
+		                            target) - starts.begin();
+	}
+	first[tasks] = items;
+
+	std::deque<Part> parts(tasks);
+	WorkPool pool(threads);
+	pool.run(tasks, [&](size_t t) {
+		Part &part = parts[t];
+		size_t a = first[t], b = first[t+1];
+		if(a == b) {
+			part.complete = true;
+			return;
+		}
+
+		uint32_t begin = starts[a], end = starts[b];
+		TokenCursor cursor(tokens, begin, index.lexemeAt[begin]);
+		IBTLParser<TokenCursor> parser(cursor, part.ast);
+		try {
+			parser.parseScopes(b - a, part.roots);
+			// the parser has read one token past the group
+			part.complete = cursor.position() == end + 1;
+		}
+		catch(ParseException &) {
+			part.error = std::current_exception();
+		}
+	});
+
+	// the first group that failed is where the serial parser would have
+	// stopped
+	for(Part &part : parts) {
+		if(part.error) std::rethrow_exception(part.error);
+		if(!part.complete) return NULL;
+	}
+
+	std::vector<NodeId> base(tasks);
+	std::vector<size_t> childBase(tasks);
+	size_t nodes = 0, children = 0;
+	for(size_t t = 0; t < tasks; t++) {
+		base[t] = ast.size() + nodes;
+		childBase[t] = ast.childIds.size() + children;
+		nodes += parts[t].ast.size();
+		children += parts[t].ast.childIds.size();
+	}
+	ast.reserve(nodes, children);
+	pool.run(tasks, [&](size_t t) {
+		ast.splice(parts[t].ast, base[t], childBase[t]);
+	});
+
+	std::vector<Node *> roots;
+	for(Part &part : parts) {
+		ast.arena.adopt(part.ast.arena);
+		roots.insert(roots.end(), part.roots.begin(), part.roots.end());
+	}
+
+	// the lines the serial parser would give them: the first item's
+	// token and the closing bracket
+	ContainerScopeNode *sc = new (ast.arena) ContainerScopeNode(ast,
+		tokens.lines[1], NodeList(roots.data(), roots.size()));
+	return new (ast.arena) ProgramNode(ast, sc, tokens.lines[n-2]);
+}
+
+}
+
+ProgramNode *parseParallel(TokenBuffer &tokens, Ast &ast, unsigned threads)
+{
+	if(threads > 1 && tokens.size() >= MIN_TOKENS) {
+		ProgramNode *p = parseSplit(tokens, ast, threads);
+		if(p) return p;
+	}
+
+	TokenCursor cursor(tokens);
+	IBTLParser<TokenCursor> parser(cursor, ast);
+	return parser.parse();
+}
@@ -0,0 +1,146 @@
+#include <parser/treedump.h>
+#include <parser/walk.h>
+#include <algorithm>
+#include <cstring>
+
+static const char *kindName(NodeKind kind)
+{
+	switch(kind) {
+	case NK_PROGRAM: return "program";
+	case NK_SCOPE: return "scope";
+	case NK_EXPRLIST: return "exprlist";
+	case NK_VARLIST: return "varlist";
+	case NK_IDLIST: return "idlist";
+	case NK_TYPELIST: return "typelist";
+	case NK_BINOP: return "binop";
+	case NK_UNOP: return "unop";
+	case NK_ASSIGN: return "assign";
+	case NK_CALL: return "call";
+	case NK_IF: return "if";
+	case NK_WHILE: return "while";
+	case NK_LET: return "let";
+	case NK_FUNCTION: return "function";
+	case NK_PRINT: return "print";
+	default: return "";
+	}
+}
+
+void TreeDumper::flush()
+{
+	if(used) out.write(buf.data(), used);
+	used = 0;
+}
+
+void TreeDumper::write(const char *s, size_t n)
+{
+	while(n) {
+		if(used == buf.size()) flush();
+		size_t len = std::min(n, buf.size() - used);
+		memcpy(buf.data() + used, s, len);
+		used += len;
+		s += len;
+		n -= len;
+	}
+}
+
+void TreeDumper::indent(int depth)
+{
+	if(tabs.size() < size_t(depth)) tabs.resize(depth, '\t');
+	write(tabs.data(), depth);
+}
+
+void TreeDumper::putU32(uint32_t v)
+{
+	for(int i = 0; i < 4; i++) put(char(v >> (8 * i)));
+}
+
+void TreeDumper::token(TokNode *tok)
+{
+	const Token &t = tok->token;
+	switch(format) {
+	case DUMP_TEXT:
+		// as operator<<(std::ostream &, Token &) prints it
+		put('<');
+		write(Token::nameToString(t.name));
+		write(", ", 2);
+		write(Token::attrToString(t.attr));
+		if(!t.val.empty()) {
+			write(", ", 2);
+			write(t.val);
+		}
+		put('>');
+		break;
+	case DUMP_SEXPR:
+		if(t.val.empty()) write(Token::attrToString(tok->attr()));
+		else write(t.val);
+		break;
+	case DUMP_BINARY:
+		put(char(t.name));
+		put(char(t.attr));
+		putU32(t.val.size());
+		write(t.val);
+		break;
+	}
+}
+
+Node *TreeDumper::step(Node *node, int step, int depth, int &childDepth)
+{
+	int count = node->isToken() ? 0 : node->childCount();
+	childDepth = depth + 1;
+
+	if(step == 0) {
+		switch(format) {
+		case DUMP_TEXT:
+			indent(depth);
+			if(node->isToken())
+				token(nodeCast<TokNode>(node));
+			else {
+				put('[');
+				write(kindName(node->kind()));
+			}
+			put('\n');
+			break;
+		case DUMP_SEXPR:
+			if(depth > 0) put(' ');
+			if(node->isToken())
+				token(nodeCast<TokNode>(node));
+			else {
+				put('(');
+				write(kindName(node->kind()));
+			}
+			break;
+		case DUMP_BINARY:
+			put(char(node->kind()));
+			putU32(node->line());
+			if(node->isToken())
+				token(nodeCast<TokNode>(node));
+			else
+				putU32(count);
+			break;
+		}
+	}
+
+	if(step < count) return node->child(step);
+	if(node->isToken()) return NULL;
+
+	switch(format) {
+	case DUMP_TEXT:
+		indent(depth);
+		write("]\n", 2);
+		break;
+	case DUMP_SEXPR:
+		put(')');
+		break;
+	case DUMP_BINARY:
+		break;
+	}
+	return NULL;
+}
+
+void TreeDumper::dump(Node *root)
+{
+	if(format == DUMP_BINARY) write("IBT1", 4);
+	walkTree(root, 0, *this);
+	if(format == DUMP_SEXPR) put('\n');
+	flush();
+}
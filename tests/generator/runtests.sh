@@ -3,16 +3,22 @@
 COMPILER=../../compiler
 TESTLIST=testlist
 FLOAT_DELTA=0.001
+# every other mode must generate the same code as the default mode.
+# -z alone skips the bodies of functions that are never called, so it
+# may compile a program the default mode rejects
+MODES=("-l" "-b" "-j 4" "-z" "-z -c")
 i=0
 while read line
 do
     testfile=$(echo $line | sed 's_^\(.*\),.*$_\1_' )
     exp_result=$(echo $line | sed 's_^.*,\(.*\)$_\1_' )
+    # a test may give flags of its own before the file name
+    inputfile=$(echo $testfile | awk '{ print $NF }')
 
     echo "test ${i}:"
     echo "==========================================="
     echo "INPUT: "
-    cat $testfile
+    cat $inputfile
     echo "OUTPUT: "
     $COMPILER -o deleteme.f $testfile
     returncode=$?
@@ -45,6 +51,25 @@ do
     else
         echo "FAIL"
     fi
+
+    # a test with flags of its own is only run with those
+    modes=("${MODES[@]}")
+    if [[ $testfile == -* ]] ; then modes=() ; fi
+    for mode in "${modes[@]}"
+    do
+        $COMPILER $mode -o modes.f $testfile > /dev/null
+        modecode=$?
+        if [[ $mode == "-z" && $returncode != 0 ]] ; then
+            echo "MODE ${mode}: not compared"
+        elif [[ $modecode != $returncode ]] ; then
+            echo "MODE ${mode}: FAIL"
+        elif [[ $returncode == 0 ]] && ! cmp -s modes.f deleteme.f ; then
+            echo "MODE ${mode}: FAIL"
+        else
+            echo "MODE ${mode}: PASS"
+        fi
+        rm -f modes.f
+    done
         
     echo
     i=$( expr $i + 1 )
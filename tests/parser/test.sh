@@ -2,8 +2,81 @@
 
 # this shell script runs tests in a given directory. TESTDIR
 # must be set to the desired directory when running this script.
+# Every test is then run again in each of MODES, which must print
+# the same output and generate the same code as the default mode,
+# and must print the same tokens and trees for each of VIEWS.
 
 RUNFLAGS=
+MODES=("-l" "-b" "-j 4" "-z" "-z -c" "pipe")
+# the tokens and the tree dumps, each compared between the modes too
+VIEWS=("-t" "-d sexpr" "-d binary")
+
+# runs the compiler on the given flags and file, writing its exit
+# status, its output and the code it generated to the file named
+# first. Files, because a binary dump holds NUL bytes
+run_compiler() {
+	local out=$1
+	shift
+	./compiler -o modes.f "$@" > modes.out
+	echo "exit status $?" > $out
+	cat modes.out modes.f >> $out 2> /dev/null
+	rm -f modes.out modes.f
+}
+
+# compares every mode against the default mode on one test file. The
+# buffered modes lex the whole file before parsing, so an input with
+# both a lexer and a parse error can report either one: where the
+# default mode fails, a mode only has to fail too. -z alone never
+# checks the bodies of functions that are not called, so it is only
+# compared where the default mode succeeds. The pipe mode feeds the
+# file through a pipe, which is read through an istream instead of
+# being mapped
+compare_modes() {
+	local test=$1
+	local status
+	run_compiler base.modes $RUNFLAGS $test
+	read -r status < base.modes
+	for mode in "${MODES[@]}"
+	do
+		local name=$(echo $RUNFLAGS $mode)
+		if [[ $mode == "pipe" ]] ; then
+			cat $test | run_compiler mode.modes $RUNFLAGS /dev/stdin
+		else
+			run_compiler mode.modes $RUNFLAGS $mode $test
+		fi
+		if [[ $status == "exit status 0" ]] ; then
+			cmp -s base.modes mode.modes
+		elif [[ $mode == "-z" ]] ; then
+			echo "mode ${name}: not compared"
+			continue
+		else
+			cmp -s <(head -n 1 base.modes) <(head -n 1 mode.modes)
+		fi
+		if [[ $? == 0 ]] ; then
+			echo "mode ${name}: same"
+		else
+			echo "mode ${name}: DIFFERS"
+		fi
+	done
+	rm -f base.modes mode.modes
+}
+
+# prints a program of about 4.5MB, so that -j 4 lexes it in four
+# chunks, some of them starting inside a string literal, and parses
+# its 1.3 million tokens on four threads
+make_big_input() {
+	awk 'BEGIN {
+		print "[";
+		for(i = 0; i < 20000; i++) {
+			printf "\t[let [[v%d int][s%d string]]] [:= v%d [* %d 2]]\n", i, i, i, i;
+			printf "\t[:= s%d \"a string with spaces, so a chunk can start inside it %d\"]\n", i, i;
+			printf "\t[if [< v%d 7] [stdout s%d] [stdout [^ 1.5 2]]]\n", i, i;
+			printf "\t[while [> v%d 1000000] [:= v%d [- v%d 1]]]\n", i, i, i;
+		}
+		print "]";
+	}'
+}
+
 for test in ${TESTDIR}/*
 do
 	testname=$(basename $test)
@@ -20,5 +93,24 @@ do
 	./compiler $RUNFLAGS $test > $outname
 	cat $outname
 	echo
+	if [[ $testname =~ .*\.in ]] ; then
+		compare_modes $test
+		for view in "${VIEWS[@]}"
+		do
+			RUNFLAGS=$view compare_modes $test
+		done
+		echo
+	fi
 done
 
+bigtest=$(mktemp --suffix=.in)
+make_big_input > $bigtest
+echo "running generated test $(basename $bigtest) (expected success)"
+echo "============================================="
+compare_modes $bigtest
+for view in "${VIEWS[@]}"
+do
+	RUNFLAGS=$view compare_modes $bigtest
+done
+echo
+rm -f $bigtest